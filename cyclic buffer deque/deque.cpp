@@ -0,0 +1,249 @@
+#include <deque>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "deque.h"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+template <typename D, typename T>
+bool equal(D& d, const std::deque<T>& expected)
+{
+    if (d.size() != expected.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < d.size(); i++) {
+        if (!(d[i] == expected[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// array_one() followed by array_two() is the whole contents in order
+template <typename D, typename T>
+bool arrays_equal(D& d, const std::deque<T>& expected)
+{
+    auto one = d.array_one();
+    auto two = d.array_two();
+
+    if (one.second + two.second != expected.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < one.second; i++) {
+        if (!(one.first[i] == expected[i])) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < two.second; i++) {
+        if (!(two.first[i] == expected[one.second + i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// the same random walk of pushes and pops at both ends wraps the indices around the buffer many times
+template <typename D>
+void test_wrapping(const std::string& name, size_t expected_capacity)
+{
+    D d;
+    d.reserve(5);
+    check(d.capacity() == expected_capacity, name + ": capacity of reserve(5)");
+
+    std::deque<int> expected;
+    std::mt19937 random(1);
+    bool same = true, arrays = true;
+
+    for (int i = 0; i < 100000; i++) {
+        switch (random() % 4) {
+        case 0:
+            d.push_back(i);
+            expected.push_back(i);
+            break;
+        case 1:
+            d.push_front(i);
+            expected.push_front(i);
+            break;
+        case 2:
+            if (!expected.empty()) {
+                d.pop_back();
+                expected.pop_back();
+            }
+            break;
+        case 3:
+            if (!expected.empty()) {
+                d.pop_front();
+                expected.pop_front();
+            }
+            break;
+        }
+
+        same = same && equal(d, expected);
+        arrays = arrays && arrays_equal(d, expected);
+    }
+
+    check(same, name + ": random pushes and pops at both ends");
+    check(arrays, name + ": array_one() and array_two() cover the elements in order");
+}
+
+
+template <typename D>
+void test_full(const std::string& name)
+{
+    D d;
+    d.reserve(8);
+
+    // the first cells are left behind so that the full buffer wraps around its end
+    for (int i = 0; i < 8; i++) {
+        d.push_back(i);
+    }
+    d.pop_front();
+    d.pop_front();
+    d.push_back(8);
+    d.push_back(9);
+
+    check(d.size() == 8 && d.capacity() == 8, name + ": every cell is used, there is no sentinel");
+    check(d.begin() != d.end() && d.end() - d.begin() == 8, name + ": end() of a full buffer is not begin()");
+
+    int i = 2;
+    bool ordered = true;
+    for (auto it = d.begin(); it != d.end(); ++it, i++) {
+        ordered = ordered && *it == i;
+    }
+    check(ordered && i == 10, name + ": iteration over a full wrapped buffer");
+
+    std::deque<int> expected = {2, 3, 4, 5, 6, 7, 8, 9};
+    check(arrays_equal(d, expected) && d.array_two().second == 2, name + ": arrays of a full wrapped buffer");
+    check(d.front() == 2 && d.back() == 9 && d.at(7) == 9, name + ": ends of a full wrapped buffer");
+
+    bool thrown = false;
+    try {
+        d.at(8);
+    }
+    catch(const std::out_of_range&) {
+        thrown = true;
+    }
+    check(thrown, name + ": at() beyond size()");
+}
+
+
+// the argument is an element of the deque and the deque is full, so it has to outlive the reallocation
+template <typename D>
+void test_self_references(const std::string& name)
+{
+    D d;
+    std::deque<std::string> expected;
+
+    for (int round = 0; round < 20; round++) {
+        while (d.size() < d.capacity() || d.empty()) {
+            d.push_back(std::to_string(d.size()));
+            expected.push_back(std::to_string(expected.size()));
+        }
+
+        switch (round % 4) {
+        case 0:
+            d.emplace_front(d.back());
+            expected.push_front(std::string(expected.back()));
+            break;
+        case 1:
+            d.push_front(d[d.size() / 2]);
+            expected.push_front(std::string(expected[expected.size() / 2]));
+            break;
+        case 2:
+            d.emplace_back(d.front());
+            expected.push_back(std::string(expected.front()));
+            break;
+        case 3:
+            d.push_back(d[1]);
+            expected.push_back(std::string(expected[1]));
+            break;
+        }
+    }
+
+    check(equal(d, expected), name + ": emplace and push of an element of the same deque");
+}
+
+
+template <bool PowerOfTwo>
+void test_bulk(const std::string& name)
+{
+    Deque<int, PowerOfTwo> d;
+    d.reserve(8);
+
+    std::vector<int> in = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}, out(12, -1);
+
+    d.push_back(in.data(), in.data() + 8);
+    check(d.pop_front(4, out.data()) == out.data() + 4, name + ": pop_front(n, out) returns the end of the output");
+
+    // the second batch is copied in two parts, around the end of the buffer
+    d.push_back(in.data() + 8, in.data() + 12);
+    check(d.capacity() == 8 && d.array_two().second == 4, name + ": bulk push_back wraps around the buffer");
+
+    std::deque<int> expected = {4, 5, 6, 7, 8, 9, 10, 11};
+    check(equal(d, expected), name + ": bulk push_back across the wrap point");
+
+    check(d.pop_front(6, out.data() + 4) == out.data() + 10, name + ": bulk pop_front across the wrap point");
+    check(d.pop_front(100, out.data() + 10) == out.data() + 12 && d.empty(), name + ": pop_front of more than size()");
+    check(out == in, name + ": bulk pop_front keeps the order");
+
+    // a bulk push into a full deque reallocates once
+    d.push_back(in.data(), in.data() + 12);
+    d.push_back(in.data(), in.data() + 12);
+    check(d.size() == 24 && d[23] == 11 && d[12] == 0, name + ": bulk push_back that reallocates");
+
+    // elements that are not trivially copyable take the loops
+    Deque<std::string, PowerOfTwo> strings;
+    std::vector<std::string> words = {"a", "b", "c", "d"}, popped(4);
+
+    strings.reserve(4);
+    strings.push_back(words.begin(), words.end());
+    strings.pop_front(2, popped.begin());
+    strings.push_back(words.begin(), words.begin() + 2);
+    check(strings.capacity() == 4 && strings.array_two().second == 2,
+          name + ": bulk push_back of strings across the wrap point");
+
+    strings.pop_front(4, popped.begin());
+    check(popped == std::vector<std::string>({"c", "d", "a", "b"}) && strings.empty(),
+          name + ": bulk pop_front of strings across the wrap point");
+}
+
+
+template <bool PowerOfTwo>
+void test_deque(const std::string& name, size_t capacity_of_5)
+{
+    test_wrapping<Deque<int, PowerOfTwo>>(name, capacity_of_5);
+    test_full<Deque<int, PowerOfTwo>>(name);
+    test_self_references<Deque<std::string, PowerOfTwo>>(name);
+    test_bulk<PowerOfTwo>(name);
+}
+
+
+int main()
+{
+    test_deque<false>("Deque", 5);
+    test_deque<true>("PowerOfTwoDeque", 8);
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
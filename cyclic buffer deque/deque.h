@@ -1,5 +1,12 @@
+#pragma once
+
 #include <algorithm>
+#include <cstring>
 #include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 template <typename C>
 class DequeIterator : public std::iterator<std::random_access_iterator_tag, 
@@ -31,71 +38,81 @@ public:
 
     DequeIterator& operator++ ()
     {
-        _pos = _container._next(_pos);
+        _pos++;
         return *this;
     }
 
     DequeIterator operator++ (int)
     {
         DequeIterator tmp = *this;
-        _pos = _container._next(_pos);
+        _pos++;
         return tmp;
     }
 
     DequeIterator& operator-- ()
     {
-        _pos = _container._prev(_pos);
+        _pos--;
         return *this;
     }
 
     DequeIterator operator-- (int)
     {
         DequeIterator tmp = *this;
-        _pos = _container._prev(_pos);
+        _pos--;
         return tmp;
     }
 
     difference_type operator- (const DequeIterator& that) const
     {
-        return _container._number(_pos) - 
-          that._container._number(that._pos);
+        return static_cast<difference_type>(_pos) - static_cast<difference_type>(that._pos);
     }
 
     reference operator* ()
     {
-        return _container._data[_pos];
+        return _container[_pos];
     }
 
 private:
     C& _container;
+    // logical index, so that end() of a full buffer differs from begin()
     size_t _pos;
 };
 
 
-template <typename T>
+// cyclic buffer of exactly capacity() cells, empty and full are told apart by the size.
+// With PowerOfTwo the capacity is rounded up to a power of two and wrapping around is a mask,
+// otherwise indices are wrapped with a comparison
+template <typename T, bool PowerOfTwo = false>
 class Deque {
 public:
     typedef T                                   value_type;
     typedef T*                                  pointer;
     typedef T&                                  reference;
-    typedef DequeIterator<Deque<T>>             iterator;
+    typedef DequeIterator<Deque>                iterator;
     typedef std::reverse_iterator<iterator>     reverse_iterator;
 
-    friend iterator;
-
     Deque() :
         _data(nullptr),
-        _capacity(0),
         _size(0),
+        _capacity(0),
         _begin(0)
+    { }
+
+    Deque(const Deque& that) :
+        Deque()
     {
-        _alloc(0);
+        *this = that;
     }
 
-    Deque(const Deque<T>& that) :
+    Deque(Deque&& that) noexcept :
         Deque()
     {
-        *this = that;
+        swap(that);
+    }
+
+   ~Deque()
+    {
+        _alloc(0);
     }
 
     size_t size() const
@@ -134,30 +151,64 @@ public:
     }
 
     void push_front(const T& value)
+    {
+        emplace_front(value);
+    }
+
+    void push_front(T&& value)
+    {
+        emplace_front(std::move(value));
+    }
+
+    void push_back(const T& value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(T&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template <typename... Args>
+    T& emplace_front(Args&&... args)
     {
         if (_size == _capacity) {
+            // the arguments may refer to an element of this deque, construct before reallocating
+            T value(std::forward<Args>(args)...);
             _alloc_ahead(_size+1);
+            new(&_data[_prev(_begin)]) T(std::move(value));
+        }
+        else {
+            new(&_data[_prev(_begin)]) T(std::forward<Args>(args)...);
         }
-        
-        _data[_prev(_begin)] = value;
 
         _size++;
         _begin = _prev(_begin);
+
+        return front();
     }
 
-    void push_back(const T& value)
+    template <typename... Args>
+    T& emplace_back(Args&&... args)
     {
         if (_size == _capacity) {
+            T value(std::forward<Args>(args)...);
             _alloc_ahead(_size+1);
+            new(&_data[_end()]) T(std::move(value));
+        }
+        else {
+            new(&_data[_end()]) T(std::forward<Args>(args)...);
         }
-
-        _data[_end()] = value;
 
         _size++;
+
+        return back();
     }
 
     void pop_front()
     {
+        _data[_begin].~T();
         _size--;
         _begin = _next(_begin);
 
@@ -166,8 +217,31 @@ public:
         }
     }
 
+    // appends [first, last) with at most one reallocation; trivially copyable elements given by pointers
+    // are copied with at most two memcpy. The range must not be part of this deque
+    template <typename InputIt>
+    void push_back(InputIt first, InputIt last)
+    {
+        _push_back(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+    }
+
+    // moves the min(n, size()) first elements to `out` and removes them, returns the end of the output
+    template <typename OutputIt>
+    OutputIt pop_front(size_t n, OutputIt out)
+    {
+        n = std::min(n, _size);
+        out = _pop_front(n, out, _bitwise<OutputIt>());
+
+        if (_size < _capacity * DECREASE_FACTOR) {
+            _alloc_ahead(_size+1);
+        }
+
+        return out;
+    }
+
     void pop_back()
     {
+        back().~T();
         _size--;
 
         if (_size < _capacity * DECREASE_FACTOR) {
@@ -178,13 +252,13 @@ public:
     T& at(size_t n)
     {
         if (n >= _size) {
-            throw std::out_of_range();
+            throw std::out_of_range("Deque::at");
         }
 
         return _data[_index(n)]; 
     }
 
-    bool operator== (const Deque<T>& that) const
+    bool operator== (const Deque& that) const
     {
         return _data == that._data;
     }
@@ -204,24 +278,72 @@ public:
         return _data[_index(n)];
     }
 
-    Deque<T>& operator= (const Deque<T>& that)
-    {        
+    const T& operator[] (size_t n) const
+    {
+        return _data[_index(n)];
+    }
+
+    Deque& operator= (const Deque& that)
+    {
+        if (this == &that) {
+            return *this;
+        }
+
+        _alloc(0);
         _alloc(that.size());
-        for (size_t i = that._begin; i != that._end(); i = that._next(i)) {
-            push_back(that._data[i]);
+        for (size_t i = 0; i < that._size; i++) {
+            push_back(that[i]);
         }
 
         return *this;
     }
 
+    Deque& operator= (Deque&& that) noexcept
+    {
+        Deque tmp(std::move(that));
+        swap(tmp);
+
+        return *this;
+    }
+
+    void swap(Deque& that) noexcept
+    {
+        std::swap(_data, that._data);
+        std::swap(_size, that._size);
+        std::swap(_capacity, that._capacity);
+        std::swap(_begin, that._begin);
+    }
+
+    // the live elements are array_one() followed by array_two(), which is empty unless they wrap around;
+    // both stay valid until the next reallocation, e.g. to hand the contents to writev() without copying
+    std::pair<T*, size_t> array_one()
+    {
+        return std::make_pair(_data + _begin, std::min(_size, _capacity - _begin));
+    }
+
+    std::pair<T*, size_t> array_two()
+    {
+        return std::make_pair(_data, _size - std::min(_size, _capacity - _begin));
+    }
+
+    std::pair<const T*, size_t> array_one() const
+    {
+        return std::make_pair(_data + _begin, std::min(_size, _capacity - _begin));
+    }
+
+    std::pair<const T*, size_t> array_two() const
+    {
+        return std::make_pair(_data, _size - std::min(_size, _capacity - _begin));
+    }
+
     iterator begin()
     {
-        return iterator(*this, _begin);
+        return iterator(*this, 0);
     }
 
     iterator end()
     {
-        return iterator(*this, _end());
+        return iterator(*this, _size);
     }
 
     reverse_iterator rbegin()
@@ -244,60 +366,175 @@ private:
     size_t _begin;
 
 
+    // n < 2 * _capacity
+    size_t _wrap(size_t n) const
+    {
+        if (PowerOfTwo) {
+            return n & (_capacity - 1);
+        }
+
+        return n < _capacity ? n : n - _capacity;
+    }
+
     size_t _end() const
     {
-        return (_begin + _size) % (_capacity + 1);
+        return _wrap(_begin + _size);
     }
 
-    size_t _next(size_t n, size_t offset = 1) const
+    size_t _next(size_t n) const
     {
-        return (n + offset) % (_capacity + 1);
+        return _wrap(n + 1);
     }
 
-    size_t _prev(size_t n, size_t offset = 1) const
+    size_t _prev(size_t n) const
     {
-        return (offset > n) ? (_capacity + 1) - (offset - n) : n - offset;        
+        return _wrap(n + _capacity - 1);
     }
 
     size_t _index(size_t n) const
     {
-        return _next(_begin + n, 0);
+        return _wrap(_begin + n);
+    }
+
+    static size_t _round_capacity(size_t n)
+    {
+        if (!PowerOfTwo || n == 0) {
+            return n;
+        }
+
+        size_t capacity = 1;
+        while (capacity < n) {
+            capacity *= 2;
+        }
+
+        return capacity;
     }
 
-    size_t _number(size_t n) const
+    // whether elements can be copied between the buffer and pointers of type It with memcpy
+    template <typename It>
+    using _bitwise = std::integral_constant<bool, std::is_trivially_copyable<T>::value && std::is_pointer<It>::value
+        && std::is_same<typename std::remove_cv<typename std::remove_pointer<It>::type>::type, T>::value>;
+
+    template <typename InputIt>
+    void _push_back(InputIt first, InputIt last, std::input_iterator_tag)
     {
-        return _prev(n, _begin);
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
     }
 
-    void _alloc(size_t n)
+    template <typename ForwardIt>
+    void _push_back(ForwardIt first, ForwardIt last, std::forward_iterator_tag)
     {
-        T* tmp;
+        size_t n = std::distance(first, last);
 
-        try {
-            size_t new_size = std::min(_size, n);       
+        if (_size + n > _capacity) {
+            _alloc_ahead(_size + n);
+        }
+
+        _push_back_reserved(first, n, _bitwise<ForwardIt>());
+    }
+
+    template <typename Pointer>
+    void _push_back_reserved(Pointer first, size_t n, std::true_type)
+    {
+        size_t end = _end();
+        size_t head = std::min(n, _capacity - end);
+
+        if (n > 0) {
+            std::memcpy(_data + end, first, head * sizeof(T));
+            std::memcpy(_data, first + head, (n - head) * sizeof(T));
+        }
 
-            // allocating n + 1 cells to save one for the end index since deque is implemented like a cyclic buffer
-            tmp = new T [n + 1];
+        _size += n;
+    }
 
-            for (size_t i = _begin, j = 0; i != _end(); i = _next(i), j++) {
-                tmp[j] = _data[i];
+    template <typename ForwardIt>
+    void _push_back_reserved(ForwardIt first, size_t n, std::false_type)
+    {
+        for (size_t i = 0; i < n; i++, ++first) {
+            new(&_data[_end()]) T(*first);
+            _size++;
+        }
+    }
+
+    template <typename Pointer>
+    Pointer _pop_front(size_t n, Pointer out, std::true_type)
+    {
+        size_t head = std::min(n, _capacity - _begin);
+
+        if (n > 0) {
+            std::memcpy(out, _data + _begin, head * sizeof(T));
+            std::memcpy(out + head, _data, (n - head) * sizeof(T));
+            _begin = _wrap(_begin + n);
+        }
+
+        _size -= n;
+
+        return out + n;
+    }
+
+    template <typename OutputIt>
+    OutputIt _pop_front(size_t n, OutputIt out, std::false_type)
+    {
+        for (size_t i = 0; i < n; i++, ++out) {
+            *out = std::move(_data[_begin]);
+            _data[_begin].~T();
+            _begin = _next(_begin);
+            _size--;
+        }
+
+        return out;
+    }
+
+    // only the live cells hold objects: they are moved to the new buffer if that cannot throw and copied otherwise,
+    // so a throwing copy leaves the deque intact
+    void _alloc(size_t n)
+    {
+        n = _round_capacity(n);
+
+        std::allocator<T> allocator;
+        size_t new_size = std::min(_size, n);
+        T* tmp = n > 0 ? allocator.allocate(n) : nullptr;
+        size_t moved = 0;
+
+        try {
+            for (; moved < new_size; moved++) {
+                new(tmp + moved) T(std::move_if_noexcept(_data[_index(moved)]));
             }
-            std::swap(tmp, _data);
-            _size = new_size;
-            _capacity = n;
-            _begin = 0;
         }
-        // finally  emulation
         catch(...) {
-            delete[] tmp;
+            for (size_t i = 0; i < moved; i++) {
+                tmp[i].~T();
+            }
+            allocator.deallocate(tmp, n);
             throw;
         }
 
-        delete[] tmp;
+        for (size_t i = 0; i < _size; i++) {
+            _data[_index(i)].~T();
+        }
+        if (_data != nullptr) {
+            allocator.deallocate(_data, _capacity);
+        }
+
+        _data = tmp;
+        _size = new_size;
+        _capacity = n;
+        _begin = 0;
     }
 
+    // a rounded up capacity may be the current one, then there is nothing to do
     void _alloc_ahead(size_t n)
     {
-        _alloc(n * INCREASE_FACTOR);
+        size_t capacity = _round_capacity(n * INCREASE_FACTOR);
+
+        if (capacity != _capacity) {
+            _alloc(capacity);
+        }
     }
-};
\ No newline at end of file
+};
+
+
+template <typename T>
+using PowerOfTwoDeque = Deque<T, true>;
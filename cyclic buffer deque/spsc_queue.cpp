@@ -0,0 +1,142 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.h"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+void test_single()
+{
+    SpscQueue<std::string> queue(3);
+    std::string value;
+
+    check(queue.capacity() == 4, "capacity is rounded up to a power of two");
+    check(!queue.try_pop(value), "pop from an empty queue");
+
+    for (int i = 0; i < 4; i++) {
+        check(queue.try_push(std::to_string(i)), "push into a queue with room");
+    }
+    check(!queue.try_push("4"), "push into a full queue");
+    check(queue.size() == 4, "size of a full queue");
+
+    // every cell is used several times, the counters wrap around the buffer
+    for (int i = 4; i < 20; i++) {
+        check(queue.try_pop(value) && value == std::to_string(i - 4), "pop in push order");
+        check(queue.try_push(std::to_string(i)), "push after a pop");
+    }
+
+    for (int i = 16; i < 20; i++) {
+        check(queue.try_pop(value) && value == std::to_string(i), "pop after the wrap");
+    }
+    check(queue.size() == 0, "size of a drained queue");
+
+    check(queue.try_emplace(3, 'x') && queue.try_pop(value) && value == "xxx", "emplace");
+}
+
+
+void test_batch()
+{
+    SpscQueue<int> queue(64);
+    std::vector<int> in(64), out(64);
+
+    for (int i = 0; i < 64; i++) {
+        in[i] = i;
+    }
+
+    // the cached counters are stale after the drain, the batches must still see the whole queue
+    check(queue.try_push(in.data(), in.data() + 63) == 63, "batch push of 63");
+    check(queue.try_pop(out.data(), 63) == 63, "batch pop of 63");
+    check(queue.try_push(in.data(), in.data() + 64) == 64, "batch push of 64 into a drained queue");
+    check(queue.try_pop(out.data(), 64) == 64, "batch pop of 64 from a full queue");
+
+    bool ordered = true;
+    for (int i = 0; i < 64; i++) {
+        ordered = ordered && out[i] == i;
+    }
+    check(ordered, "batch across the wrap point keeps the order");
+
+    check(queue.try_push(in.data(), in.data() + 40) == 40, "batch push of 40");
+    check(queue.try_push(in.data(), in.data() + 40) == 24, "batch push stops when the queue is full");
+    check(queue.try_pop(out.data(), 64) == 64, "batch pop of everything");
+    check(queue.try_pop(out.data(), 64) == 0, "batch pop from an empty queue");
+
+    SpscQueue<std::string> strings(8);
+    std::vector<std::string> words = {"a", "b", "c", "d", "e", "f"}, popped(6);
+
+    check(strings.try_push(words.begin(), words.end()) == 6, "batch push of strings");
+    check(strings.try_pop(popped.begin(), 4) == 4, "batch pop of strings");
+    check(strings.try_push(words.begin(), words.end()) == 6, "batch push of strings across the wrap point");
+    check(strings.try_pop(popped.begin(), 6) == 6 && popped[0] == "e" && popped[2] == "a" && popped[5] == "d",
+          "batch pop of strings across the wrap point");
+}
+
+
+void test_threads(bool batch)
+{
+    const size_t count = 1000000;
+
+    SpscQueue<size_t> queue(1024);
+    size_t sum = 0;
+    bool ordered = true;
+
+    std::thread producer([&]() {
+        size_t buffer[100];
+
+        for (size_t next = 0; next < count; ) {
+            if (!batch) {
+                next += queue.try_push(next);
+                continue;
+            }
+
+            size_t n = std::min<size_t>(100, count - next);
+            for (size_t i = 0; i < n; i++) {
+                buffer[i] = next + i;
+            }
+            for (size_t pushed = 0; pushed < n; ) {
+                pushed += queue.try_push(buffer + pushed, buffer + n);
+            }
+            next += n;
+        }
+    });
+
+    size_t buffer[64];
+
+    for (size_t expected = 0; expected < count; ) {
+        size_t n = batch ? queue.try_pop(buffer, 64) : queue.try_pop(buffer[0]);
+
+        for (size_t i = 0; i < n; i++, expected++) {
+            ordered = ordered && buffer[i] == expected;
+            sum += buffer[i];
+        }
+    }
+
+    producer.join();
+
+    check(ordered, "consumer sees the producer order");
+    check(sum == count * (count - 1) / 2, "consumer sees every element once");
+}
+
+
+int main()
+{
+    test_single();
+    test_batch();
+    test_threads(false);
+    test_threads(true);
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
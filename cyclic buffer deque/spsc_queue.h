@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+
+// fixed capacity queue between exactly one producer thread and one consumer thread: the cyclic layout
+// of PowerOfTwoDeque with free-running head and tail counters instead of a size, so each side writes
+// only its own index. Every operation is wait-free. Each side keeps the last value it saw of the other index
+// and reloads it only when that value does not leave room for (or hold) what is asked, so the indices
+// rarely move between cores
+
+const size_t SPSC_CACHE_LINE = 64;
+
+
+template <typename T>
+class SpscQueue {
+public:
+    // the capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity) :
+        _data(nullptr),
+        _capacity(1)
+    {
+        while (_capacity < capacity) {
+            _capacity *= 2;
+        }
+
+        _data = std::allocator<T>().allocate(_capacity);
+        _mask = _capacity - 1;
+
+        _tail.store(0, std::memory_order_relaxed);
+        _cached_head = 0;
+        _head.store(0, std::memory_order_relaxed);
+        _cached_tail = 0;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator= (const SpscQueue&) = delete;
+
+    // neither thread may use the queue anymore
+   ~SpscQueue()
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+
+        for (size_t i = _head.load(std::memory_order_relaxed); i != tail; i++) {
+            _data[i & _mask].~T();
+        }
+
+        std::allocator<T>().deallocate(_data, _capacity);
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    // exact only when called by one of the two threads while the other one is idle
+    size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+    // producer side, false when the queue is full
+    bool try_push(const T& value)
+    {
+        return try_emplace(value);
+    }
+
+    bool try_push(T&& value)
+    {
+        return try_emplace(std::move(value));
+    }
+
+    template <typename... Args>
+    bool try_emplace(Args&&... args)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+
+        if (_free(tail, 1) == 0) {
+            return false;
+        }
+
+        new(&_data[tail & _mask]) T(std::forward<Args>(args)...);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // producer side, pushes as many elements of [first, last) as fit and publishes them at once;
+    // returns how many were pushed
+    template <typename ForwardIt>
+    size_t try_push(ForwardIt first, ForwardIt last)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t n = std::distance(first, last);
+        n = std::min(n, _free(tail, n));
+
+        _copy_in(tail, first, n, _bitwise<ForwardIt>());
+        _tail.store(tail + n, std::memory_order_release);
+
+        return n;
+    }
+
+    // consumer side, false when the queue is empty
+    bool try_pop(T& value)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        if (_available(head, 1) == 0) {
+            return false;
+        }
+
+        T& slot = _data[head & _mask];
+        value = std::move(slot);
+        slot.~T();
+        _head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // consumer side, moves up to n elements to `out` and releases their cells at once; returns how many were popped
+    template <typename OutputIt>
+    size_t try_pop(OutputIt out, size_t n)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        n = std::min(n, _available(head, n));
+
+        _move_out(head, out, n, _bitwise<OutputIt>());
+        _head.store(head + n, std::memory_order_release);
+
+        return n;
+    }
+
+private:
+    // written by nobody after construction
+    alignas(SPSC_CACHE_LINE) T* _data;
+    size_t _capacity;
+    size_t _mask;
+
+    // written by the producer only
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> _tail;
+    size_t _cached_head;
+
+    // written by the consumer only
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> _head;
+    size_t _cached_tail;
+
+    template <typename It>
+    using _bitwise = std::integral_constant<bool, std::is_trivially_copyable<T>::value && std::is_pointer<It>::value
+        && std::is_same<typename std::remove_cv<typename std::remove_pointer<It>::type>::type, T>::value>;
+
+    // free cells as seen by the producer, the head is reloaded only if the cached one leaves fewer than n
+    size_t _free(size_t tail, size_t n)
+    {
+        if (_capacity - (tail - _cached_head) < n) {
+            _cached_head = _head.load(std::memory_order_acquire);
+        }
+
+        return _capacity - (tail - _cached_head);
+    }
+
+    // elements as seen by the consumer, the tail is reloaded only if the cached one holds fewer than n
+    size_t _available(size_t head, size_t n)
+    {
+        if (_cached_tail - head < n) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+        }
+
+        return _cached_tail - head;
+    }
+
+    template <typename Pointer>
+    void _copy_in(size_t tail, Pointer first, size_t n, std::true_type)
+    {
+        size_t pos = tail & _mask;
+        size_t head = std::min(n, _capacity - pos);
+
+        if (n > 0) {
+            std::memcpy(_data + pos, first, head * sizeof(T));
+            std::memcpy(_data, first + head, (n - head) * sizeof(T));
+        }
+    }
+
+    // if a copy throws, the elements constructed before it are published and the exception is rethrown
+    template <typename ForwardIt>
+    void _copy_in(size_t tail, ForwardIt first, size_t n, std::false_type)
+    {
+        size_t i = 0;
+
+        try {
+            for (; i < n; i++, ++first) {
+                new(&_data[(tail + i) & _mask]) T(*first);
+            }
+        }
+        catch(...) {
+            _tail.store(tail + i, std::memory_order_release);
+            throw;
+        }
+    }
+
+    template <typename Pointer>
+    void _move_out(size_t head, Pointer out, size_t n, std::true_type)
+    {
+        size_t pos = head & _mask;
+        size_t first = std::min(n, _capacity - pos);
+
+        if (n > 0) {
+            std::memcpy(out, _data + pos, first * sizeof(T));
+            std::memcpy(out + first, _data, (n - first) * sizeof(T));
+        }
+    }
+
+    template <typename OutputIt>
+    void _move_out(size_t head, OutputIt out, size_t n, std::false_type)
+    {
+        for (size_t i = 0; i < n; i++, ++out) {
+            T& slot = _data[(head + i) & _mask];
+            *out = std::move(slot);
+            slot.~T();
+        }
+    }
+};
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "argsort.hpp"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+// the stable permutation that std::stable_sort finds, `strict` orders the same way as the tested comparator
+template <typename Key, typename Strict>
+std::vector<size_t> reference(const std::vector<Key>& keys, Strict strict)
+{
+    std::vector<size_t> indices(keys.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+        return strict(keys[a], keys[b]);
+    });
+
+    return indices;
+}
+
+
+struct Record {
+    int key;
+    std::string payload;
+
+    bool operator== (const Record& that) const
+    {
+        return key == that.key && payload == that.payload;
+    }
+};
+
+
+template <typename Key, typename Comparator, typename Strict>
+void test(const std::string& name, const std::vector<Key>& keys, Comparator cmp, Strict strict)
+{
+    std::vector<size_t> expected = reference(keys, strict);
+
+    check(argsort(keys.begin(), keys.end(), cmp) == expected, name + ": argsort");
+    check(argsort_by_key(keys.begin(), keys.end(), [](const Key& key) { return key; }, cmp) == expected,
+          name + ": argsort_by_key");
+
+    std::vector<Key> sorted = keys;
+    sort_by_key(sorted.begin(), sorted.end(), [](const Key& key) { return key; }, cmp);
+
+    std::vector<Key> expected_sorted = keys;
+    std::stable_sort(expected_sorted.begin(), expected_sorted.end(), strict);
+    check(sorted == expected_sorted, name + ": sort_by_key");
+}
+
+
+void test_records(size_t size)
+{
+    std::mt19937 random(size);
+    std::vector<Record> records;
+
+    for (size_t i = 0; i < size; i++) {
+        records.push_back({static_cast<int>(random() % 100) - 50, "record " + std::to_string(i)});
+    }
+
+    // records of equal keys keep their order, which their payloads tell apart
+    std::vector<Record> expected = records;
+    std::stable_sort(expected.begin(), expected.end(), [](const Record& a, const Record& b) { return a.key < b.key; });
+
+    std::vector<Record> sorted = records;
+    sort_by_key(sorted.begin(), sorted.end(), [](const Record& record) { return record.key; }, std::less<int>());
+    check(sorted == expected, "sort_by_key of records of " + std::to_string(size) + " by ascending int keys");
+
+    std::stable_sort(expected.begin(), expected.end(), [](const Record& a, const Record& b) { return a.key > b.key; });
+    sorted = records;
+    sort_by_key(sorted.begin(), sorted.end(), [](const Record& record) { return record.key; }, std::greater<int>());
+    check(sorted == expected, "sort_by_key of records of " + std::to_string(size) + " by descending int keys");
+
+    std::vector<std::string> payloads;
+    for (auto& record: records) {
+        payloads.push_back(record.payload);
+    }
+    std::vector<size_t> order = reference(payloads, std::less<std::string>());
+
+    sorted = records;
+    sort_by_key(sorted.begin(), sorted.end(), [](const Record& record) { return record.payload; },
+                std::less<std::string>());
+    bool same = sorted.size() == order.size();
+    for (size_t i = 0; same && i < order.size(); i++) {
+        same = sorted[i] == records[order[i]];
+    }
+    check(same, "sort_by_key of records of " + std::to_string(size) + " by string keys");
+}
+
+
+void test_apply_permutation(size_t size)
+{
+    std::mt19937 random(size);
+
+    std::vector<size_t> permutation(size);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::shuffle(permutation.begin(), permutation.end(), random);
+
+    std::vector<std::string> values, expected;
+    for (size_t i = 0; i < size; i++) {
+        values.push_back(std::to_string(i));
+    }
+    for (size_t i = 0; i < size; i++) {
+        expected.push_back(values[permutation[i]]);
+    }
+
+    apply_permutation(values.begin(), permutation);
+    check(values == expected, "apply_permutation of a random permutation of " + std::to_string(size));
+
+    // the identity and one cycle through every element
+    std::vector<size_t> identity(size), rotation(size);
+    std::iota(identity.begin(), identity.end(), 0);
+    for (size_t i = 0; i < size; i++) {
+        rotation[i] = (i + 1) % size;
+    }
+
+    values = expected;
+    apply_permutation(values.begin(), identity);
+    check(values == expected, "apply_permutation of the identity of " + std::to_string(size));
+
+    apply_permutation(values.begin(), rotation);
+    std::rotate(expected.begin(), expected.begin() + std::min<size_t>(1, size), expected.end());
+    check(values == expected, "apply_permutation of one cycle of " + std::to_string(size));
+}
+
+
+int main()
+{
+    for (size_t size: {0, 1, 2, 10, 100, 1000, 100000}) {
+        std::mt19937 random(size);
+        std::vector<int> ints(size), few(size);
+        std::vector<double> doubles(size);
+        std::vector<std::string> strings(size);
+
+        for (size_t i = 0; i < size; i++) {
+            ints[i] = static_cast<int>(random());
+            few[i] = random() % 4 - 2;
+            doubles[i] = (static_cast<double>(random()) - 2e9) / 7;
+            strings[i] = std::to_string(random() % 1000);
+        }
+
+        std::string of = " of " + std::to_string(size);
+
+        // ascending arithmetic keys go through radix sort, the rest through qsort
+        test("ints" + of, ints, std::less<int>(), std::less<int>());
+        test("few distinct ints" + of, few, std::less<int>(), std::less<int>());
+        test("few distinct ints less or equal" + of, few, std::less_equal<int>(), std::less<int>());
+        test("few distinct ints descending" + of, few, std::greater<int>(), std::greater<int>());
+        test("doubles" + of, doubles, std::less<double>(), std::less<double>());
+        test("doubles descending" + of, doubles, std::greater<double>(), std::greater<double>());
+        test("strings" + of, strings, std::less<std::string>(), std::less<std::string>());
+        test("strings less or equal" + of, strings, std::less_equal<std::string>(), std::less<std::string>());
+
+        test_records(size);
+        test_apply_permutation(size);
+    }
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "qsort.hpp"
+#include "radix_sort.hpp"
+
+
+// orders indices by the elements they point to, ties go to the smaller index so the order is stable
+template <typename RandomIt, typename Comparator>
+struct IndexComparator {
+    RandomIt begin;
+    Comparator cmp;
+
+    bool operator() (size_t a, size_t b) const
+    {
+        return cmp(*(begin + a), *(begin + b)) || (!cmp(*(begin + b), *(begin + a)) && a < b);
+    }
+};
+
+
+template <typename RandomIt, typename Comparator>
+std::vector<size_t> argsort_strict(RandomIt begin, RandomIt end, Comparator cmp)
+{
+    std::vector<size_t> indices(std::distance(begin, end));
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+
+    qsort(indices.begin(), indices.end(), IndexComparator<RandomIt, Comparator>{begin, cmp});
+
+    return indices;
+}
+
+
+// permutation that sorts [begin, end) stably: element indices[i] goes to position i; the elements are not moved
+template <typename RandomIt, typename Comparator>
+std::vector<size_t> argsort(RandomIt begin, RandomIt end, Comparator cmp)
+{
+    if (begin != end && cmp(*begin, *begin)) {
+        return argsort_strict(begin, end, StrictComparator<Comparator>{cmp});
+    }
+
+    return argsort_strict(begin, end, cmp);
+}
+
+
+template <typename Key, typename Comparator>
+struct KeyIndexComparator {
+    Comparator cmp;
+
+    bool operator() (const std::pair<Key, size_t>& a, const std::pair<Key, size_t>& b) const
+    {
+        return cmp(a.first, b.first) || (!cmp(b.first, a.first) && a.second < b.second);
+    }
+};
+
+
+struct KeyOfPair {
+    template <typename Key>
+    const Key& operator() (const std::pair<Key, size_t>& pair) const
+    {
+        return pair.first;
+    }
+};
+
+
+// ascending arithmetic keys are sorted by radix, which is stable by itself
+template <typename Key, typename Comparator>
+typename std::enable_if<std::is_arithmetic<Key>::value && is_ascending_comparator<Comparator, Key>::value>::type
+sort_decorated(std::vector<std::pair<Key, size_t>>& decorated, Comparator)
+{
+    radix_sort(decorated.begin(), decorated.end(), KeyOfPair());
+}
+
+template <typename Key, typename Comparator>
+typename std::enable_if<!(std::is_arithmetic<Key>::value && is_ascending_comparator<Comparator, Key>::value)>::type
+sort_decorated(std::vector<std::pair<Key, size_t>>& decorated, Comparator cmp)
+{
+    if (!decorated.empty() && cmp(decorated[0].first, decorated[0].first)) {
+        qsort(decorated.begin(), decorated.end(), KeyIndexComparator<Key, StrictComparator<Comparator>>{{cmp}});
+    }
+    else {
+        qsort(decorated.begin(), decorated.end(), KeyIndexComparator<Key, Comparator>{cmp});
+    }
+}
+
+
+// like argsort() but orders by key(element), which is computed once per element
+template <typename RandomIt, typename KeyExtractor, typename Comparator>
+std::vector<size_t> argsort_by_key(RandomIt begin, RandomIt end, KeyExtractor key, Comparator cmp)
+{
+    typedef typename std::decay<decltype(key(*begin))>::type key_type;
+
+    std::vector<std::pair<key_type, size_t>> decorated;
+    decorated.reserve(std::distance(begin, end));
+
+    size_t index = 0;
+    for (RandomIt it = begin; it != end; ++it) {
+        decorated.emplace_back(key(*it), index++);
+    }
+
+    sort_decorated(decorated, cmp);
+
+    std::vector<size_t> indices(decorated.size());
+    for (size_t i = 0; i < decorated.size(); i++) {
+        indices[i] = decorated[i].second;
+    }
+
+    return indices;
+}
+
+
+// moves element permutation[i] to position i, following the cycles of the permutation
+// so that every element is moved once plus one temporary per cycle
+template <typename RandomIt>
+void apply_permutation(RandomIt begin, std::vector<size_t> permutation)
+{
+    for (size_t i = 0; i < permutation.size(); i++) {
+        if (permutation[i] == i) {
+            continue;
+        }
+
+        auto value = std::move(*(begin + i));
+        size_t j = i;
+
+        while (permutation[j] != i) {
+            size_t next = permutation[j];
+            *(begin + j) = std::move(*(begin + next));
+            permutation[j] = j;
+            j = next;
+        }
+
+        *(begin + j) = std::move(value);
+        permutation[j] = j;
+    }
+}
+
+
+// decorate-sort-undecorate: sorts large records by a key that is extracted once, moving every record once
+template <typename RandomIt, typename KeyExtractor, typename Comparator>
+void sort_by_key(RandomIt begin, RandomIt end, KeyExtractor key, Comparator cmp)
+{
+    apply_permutation(begin, argsort_by_key(begin, end, key, cmp));
+}
@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "qsort.hpp"
+#include "simd_sort.hpp"
+
+
+const size_t MIN_MERGE = 64;
+const size_t MIN_GALLOP = 7;
+
+
+template <typename RandomIter, typename Comparator, typename Container>
+void merge(RandomIter begin, RandomIter middle, RandomIter end, Comparator cmp, Container& tmp)
+{    
+    tmp.assign(std::make_move_iterator(begin), std::make_move_iterator(middle));
+
+    if (simd_stable_merge(tmp.begin(), tmp.end(), middle, end, begin, cmp)) {
+        tmp.clear();
+        return;
+    }
+    
+    RandomIter left1 = tmp.begin(), right1 = tmp.end();
+    RandomIter left2 = middle, right2 = end;
+    RandomIter out = begin;
+
+    while ((left1 != right1) && (left2 != right2)) {
+        *out++ = cmp(*left1, *left2) ? std::move(*left1++) : std::move(*left2++);
+    }
+
+    std::move(left1, right1, out);
+
+    tmp.clear();
+}
+
+
+template <typename RandomIter, typename Comparator>
+void bottom_up_merge_sort(RandomIter begin, RandomIter end, Comparator cmp)
+{
+    size_t size = std::distance(begin, end);
+
+    if (size == 0) {
+        return;
+    }
+
+    std::vector<typename RandomIter::value_type> tmp; tmp.reserve(size/2 + 1);
+
+    // the vector kernels sort whole blocks, so merging can start from longer chunks
+    size_t sorted_size = 1;
+    if (simd_stable_sort_block(begin, std::min(begin + SIMD_SORT_BLOCK, end), cmp)) {
+        for (size_t i = SIMD_SORT_BLOCK; i < size; i += SIMD_SORT_BLOCK) {
+            simd_stable_sort_block(begin + i, std::min(begin + i + SIMD_SORT_BLOCK, end), cmp);
+        }
+        sorted_size = SIMD_SORT_BLOCK;
+    }
+
+    for (size_t chunk_size = 2*sorted_size; chunk_size < 2*size; chunk_size *= 2) {
+        for (size_t i = 0; i < size/chunk_size + (size%chunk_size != 0); ++i) {
+            RandomIter left = begin + i * chunk_size;
+            RandomIter middle = std::min(left + chunk_size/2, end);
+            RandomIter right = std::min(left + chunk_size, end);
+
+            merge(left, middle, right, cmp, tmp);
+        }        
+    }
+}
+
+
+// TimSort: merges natural runs of the input, so nearly sorted data costs close to O(n).
+// Everything below expects a strict comparator and is stable with it
+
+// length of the run starting at begin; a strictly descending run is reversed in place
+template <typename RandomIter, typename Comparator>
+size_t count_run(RandomIter begin, RandomIter end, Comparator less)
+{
+    RandomIter i = begin + 1;
+
+    if (i == end) {
+        return 1;
+    }
+
+    if (less(*i, *begin)) {
+        while (++i != end && less(*i, *(i - 1)));
+        std::reverse(begin, i);
+    }
+    else {
+        while (++i != end && !less(*i, *(i - 1)));
+    }
+
+    return i - begin;
+}
+
+
+// insertion sort of [begin, end) where [begin, sorted) is already sorted
+template <typename RandomIter, typename Comparator>
+void binary_insertion_sort(RandomIter begin, RandomIter sorted, RandomIter end, Comparator less)
+{
+    for (; sorted != end; ++sorted) {
+        RandomIter pos = std::upper_bound(begin, sorted, *sorted, less);
+        std::rotate(pos, sorted, sorted + 1);
+    }
+}
+
+
+// runs shorter than this are extended with binary insertion sort, so that n / min_run is close to a power of 2
+inline size_t min_run_length(size_t size)
+{
+    size_t odd = 0;
+
+    while (size >= MIN_MERGE) {
+        odd |= size & 1;
+        size >>= 1;
+    }
+
+    return size + odd;
+}
+
+
+// position in [first, last) that separates the elements satisfying pred from the rest;
+// probes 1, 2, 4, ... elements away from the chosen end first, so short distances take few comparisons
+template <typename RandomIter, typename Predicate>
+RandomIter gallop(RandomIter first, RandomIter last, bool from_back, Predicate pred)
+{
+    size_t size = last - first, low = 0, high = size;
+
+    if (!from_back) {
+        for (size_t offset = 1; offset <= size; offset *= 2) {
+            if (!pred(*(first + (offset - 1)))) {
+                high = offset - 1;
+                break;
+            }
+            low = offset;
+        }
+    }
+    else {
+        for (size_t offset = 1; offset <= size; offset *= 2) {
+            if (pred(*(first + (size - offset)))) {
+                low = size - offset + 1;
+                break;
+            }
+            high = size - offset;
+        }
+    }
+
+    return std::partition_point(first + low, first + high, pred);
+}
+
+
+template <typename RandomIter, typename Comparator>
+class TimSort {
+public:
+    typedef typename std::iterator_traits<RandomIter>::value_type value_type;
+
+    TimSort(RandomIter begin, RandomIter end, Comparator less) :
+        _begin(begin),
+        _less(less),
+        _min_gallop(MIN_GALLOP)
+    {
+        _tmp.reserve((end - begin) / 2 + 1);
+    }
+
+    void push_run(size_t base, size_t size)
+    {
+        _runs.push_back(std::make_pair(base, size));
+        _merge_collapse();
+    }
+
+    void merge_all()
+    {
+        while (_runs.size() > 1) {
+            size_t n = _runs.size() - 2;
+            if (n > 0 && _runs[n - 1].second < _runs[n + 1].second) {
+                n--;
+            }
+            _merge_at(n);
+        }
+    }
+
+private:
+    RandomIter _begin;
+    Comparator _less;
+    size_t _min_gallop;
+    std::vector<std::pair<size_t, size_t>> _runs;
+    std::vector<value_type> _tmp;
+
+    // keeps run lengths growing faster than Fibonacci numbers down the stack, so merges stay balanced
+    void _merge_collapse()
+    {
+        while (_runs.size() > 1) {
+            size_t n = _runs.size() - 2;
+
+            if ((n > 0 && _runs[n - 1].second <= _runs[n].second + _runs[n + 1].second) ||
+                (n > 1 && _runs[n - 2].second <= _runs[n - 1].second + _runs[n].second)) {
+                if (_runs[n - 1].second < _runs[n + 1].second) {
+                    n--;
+                }
+            }
+            else if (_runs[n].second > _runs[n + 1].second) {
+                break;
+            }
+
+            _merge_at(n);
+        }
+    }
+
+    void _merge_at(size_t n)
+    {
+        RandomIter first = _begin + _runs[n].first;
+        RandomIter middle = first + _runs[n].second;
+        RandomIter last = middle + _runs[n + 1].second;
+
+        _runs[n].second += _runs[n + 1].second;
+        _runs.erase(_runs.begin() + n + 1);
+
+        Comparator less = _less;
+
+        // elements of the left run not greater than the first right one, and elements of the right run
+        // not less than the last left one, are already in place
+        first = gallop(first, middle, false, [&](const value_type& x) { return !less(*middle, x); });
+        if (first == middle) {
+            return;
+        }
+        last = gallop(middle, last, true, [&](const value_type& x) { return less(x, *(middle - 1)); });
+
+        if (middle - first <= last - middle) {
+            _merge_low(first, middle, last);
+        }
+        else {
+            _merge_high(first, middle, last);
+        }
+    }
+
+    // merges left to right with the left run moved to the temporary buffer
+    void _merge_low(RandomIter first, RandomIter middle, RandomIter last)
+    {
+        Comparator less = _less;
+
+        _tmp.assign(std::make_move_iterator(first), std::make_move_iterator(middle));
+
+        auto left = _tmp.begin(), left_end = _tmp.end();
+        RandomIter right = middle, out = first;
+
+        while (left != left_end && right != last) {
+            size_t left_wins = 0, right_wins = 0;
+
+            while (left != left_end && right != last && (left_wins | right_wins) < _min_gallop) {
+                if (less(*right, *left)) {
+                    *out++ = std::move(*right++);
+                    right_wins++;
+                    left_wins = 0;
+                }
+                else {
+                    *out++ = std::move(*left++);
+                    left_wins++;
+                    right_wins = 0;
+                }
+            }
+
+            // one side keeps winning, copy whole stretches found by galloping instead
+            while (left != left_end && right != last) {
+                auto left_stop = gallop(left, left_end, false, [&](const value_type& x) { return !less(*right, x); });
+                left_wins = left_stop - left;
+                out = std::move(left, left_stop, out);
+                left = left_stop;
+
+                if (left == left_end) {
+                    break;
+                }
+                *out++ = std::move(*right++);
+                if (right == last) {
+                    break;
+                }
+
+                RandomIter right_stop = gallop(right, last, false, [&](const value_type& x) { return less(x, *left); });
+                right_wins = right_stop - right;
+                out = std::move(right, right_stop, out);
+                right = right_stop;
+
+                if (right == last) {
+                    break;
+                }
+                *out++ = std::move(*left++);
+
+                if (_min_gallop > 1) {
+                    _min_gallop--;
+                }
+                if (left_wins < MIN_GALLOP && right_wins < MIN_GALLOP) {
+                    _min_gallop += 2;
+                    break;
+                }
+            }
+        }
+
+        // whatever is left of the right run is already in place
+        std::move(left, left_end, out);
+    }
+
+    // merges right to left with the right run moved to the temporary buffer
+    void _merge_high(RandomIter first, RandomIter middle, RandomIter last)
+    {
+        Comparator less = _less;
+
+        _tmp.assign(std::make_move_iterator(middle), std::make_move_iterator(last));
+
+        auto right_begin = _tmp.begin(), right = _tmp.end();
+        RandomIter left = middle, out = last;
+
+        while (left != first && right != right_begin) {
+            size_t left_wins = 0, right_wins = 0;
+
+            while (left != first && right != right_begin && (left_wins | right_wins) < _min_gallop) {
+                if (less(*(right - 1), *(left - 1))) {
+                    *--out = std::move(*--left);
+                    left_wins++;
+                    right_wins = 0;
+                }
+                else {
+                    *--out = std::move(*--right);
+                    right_wins++;
+                    left_wins = 0;
+                }
+            }
+
+            while (left != first && right != right_begin) {
+                RandomIter left_stop = gallop(first, left, true, [&](const value_type& x) { return !less(*(right - 1), x); });
+                left_wins = left - left_stop;
+                out = std::move_backward(left_stop, left, out);
+                left = left_stop;
+
+                if (left == first) {
+                    break;
+                }
+                *--out = std::move(*--right);
+                if (right == right_begin) {
+                    break;
+                }
+
+                auto right_stop = gallop(right_begin, right, true, [&](const value_type& x) { return less(x, *(left - 1)); });
+                right_wins = right - right_stop;
+                out = std::move_backward(right_stop, right, out);
+                right = right_stop;
+
+                if (right == right_begin) {
+                    break;
+                }
+                *--out = std::move(*--left);
+
+                if (_min_gallop > 1) {
+                    _min_gallop--;
+                }
+                if (left_wins < MIN_GALLOP && right_wins < MIN_GALLOP) {
+                    _min_gallop += 2;
+                    break;
+                }
+            }
+        }
+
+        // whatever is left of the left run is already in place
+        std::move_backward(right_begin, right, out);
+    }
+};
+
+
+template <typename RandomIter, typename Comparator>
+void tim_sort_strict(RandomIter begin, RandomIter end, Comparator less)
+{
+    size_t size = std::distance(begin, end);
+    size_t min_run = min_run_length(size);
+
+    TimSort<RandomIter, Comparator> sorter(begin, end, less);
+
+    for (size_t base = 0; base < size; ) {
+        size_t run = count_run(begin + base, end, less);
+
+        if (run < min_run) {
+            size_t extended = std::min(min_run, size - base);
+            if (!simd_stable_sort_block(begin + base, begin + base + extended, less)) {
+                binary_insertion_sort(begin + base, begin + base + run, begin + base + extended, less);
+            }
+            run = extended;
+        }
+
+        sorter.push_run(base, run);
+        base += run;
+    }
+
+    sorter.merge_all();
+}
+
+
+template <typename RandomIter, typename Comparator>
+void tim_sort(RandomIter begin, RandomIter end, Comparator cmp)
+{
+    if (std::distance(begin, end) <= 1) {
+        return;
+    }
+
+    if (cmp(*begin, *begin)) {
+        tim_sort_strict(begin, end, StrictComparator<Comparator>{cmp});
+    }
+    else {
+        tim_sort_strict(begin, end, cmp);
+    }
+}
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include "external_sort.hpp"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+struct Record {
+    uint64_t key;
+    uint32_t index;
+    uint32_t check;
+};
+
+
+bool by_key(const Record& a, const Record& b)
+{
+    return a.key < b.key;
+}
+
+
+bool by_key_and_index(const Record& a, const Record& b)
+{
+    return a.key < b.key || (a.key == b.key && a.index < b.index);
+}
+
+
+void write_records(const std::string& path, const std::vector<Record>& records)
+{
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+}
+
+
+std::vector<Record> read_records(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    std::vector<Record> records(static_cast<size_t>(file.tellg()) / sizeof(Record));
+
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(Record));
+
+    return records;
+}
+
+
+std::vector<Record> make_records(size_t size, uint64_t distinct_keys)
+{
+    std::mt19937_64 random(size + distinct_keys);
+    std::vector<Record> records(size);
+
+    for (size_t i = 0; i < size; i++) {
+        records[i].key = random() % distinct_keys;
+        records[i].index = i;
+        records[i].check = static_cast<uint32_t>(records[i].key * 31 + i);
+    }
+
+    return records;
+}
+
+
+// memory budgets from a single chunk up to enough runs for merges of merges
+void test_sorted(const std::string& in, const std::string& out, const std::string& temp_dir)
+{
+    for (size_t size: {0, 1, 1000, 100000, 1000000}) {
+        for (size_t budget: {size_t(1) << 30, size_t(1) << 20, size_t(1) << 16}) {
+            for (uint64_t distinct: {uint64_t(-1), uint64_t(10)}) {
+                std::string name = std::to_string(size) + " records with budget " + std::to_string(budget)
+                                 + (distinct == 10 ? " and few keys" : "");
+
+                std::vector<Record> records = make_records(size, distinct);
+                write_records(in, records);
+
+                external_sort<Record>(in, out, by_key_and_index, budget, temp_dir);
+                std::sort(records.begin(), records.end(), by_key_and_index);
+
+                std::vector<Record> sorted = read_records(out);
+                bool same = sorted.size() == records.size();
+                for (size_t i = 0; same && i < sorted.size(); i++) {
+                    same = sorted[i].key == records[i].key && sorted[i].index == records[i].index
+                        && sorted[i].check == records[i].check;
+                }
+                check(same, name + ": output matches std::sort");
+
+                // equal keys in any order, but every record exactly once
+                external_sort<Record>(in, out, by_key, budget, temp_dir);
+                sorted = read_records(out);
+
+                bool ordered = std::is_sorted(sorted.begin(), sorted.end(), by_key);
+                std::sort(sorted.begin(), sorted.end(), by_key_and_index);
+                bool complete = sorted.size() == records.size();
+                for (size_t i = 0; complete && i < sorted.size(); i++) {
+                    complete = sorted[i].index == records[i].index && sorted[i].check == records[i].check;
+                }
+                check(ordered && complete, name + ": output of a comparator with ties is a sorted permutation");
+            }
+        }
+    }
+}
+
+
+template <typename Exception>
+bool throws(const std::string& in, const std::string& out, size_t budget)
+{
+    try {
+        external_sort<Record>(in, out, by_key, budget);
+        return false;
+    }
+    catch(const Exception&) {
+        return true;
+    }
+}
+
+
+void test_rejected(const std::string& in, const std::string& out)
+{
+    write_records(in, make_records(100, 10));
+    {
+        std::ofstream(in, std::ios::binary | std::ios::app) << "part";
+    }
+    check(throws<std::invalid_argument>(in, out, 1 << 20), "an input with a partial record is rejected");
+
+    write_records(in, make_records(100, 10));
+    check(throws<std::invalid_argument>(in, out, sizeof(Record)), "a budget of less than two records is rejected");
+
+    std::remove(in.c_str());
+    check(throws<std::system_error>(in, out, 1 << 20), "a missing input is reported");
+}
+
+
+int main()
+{
+    std::string base = "/tmp/external_sort_test_" + std::to_string(getpid());
+    std::string in = base + ".in", out = base + ".out";
+
+    test_sorted(in, out, "/tmp");
+    test_rejected(in, out);
+
+    std::remove(in.c_str());
+    std::remove(out.c_str());
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,622 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "top_down_merge_sort.hpp"
+
+
+// out-of-core sort of files made of fixed-size POD records: RAM-sized chunks are sorted with merge_sort()
+// and written to temporary runs, which are then k-way merged through a loser tree
+
+const size_t EXTERNAL_SORT_MIN_BLOCK = 1 << 16;
+// every merged run holds a descriptor and a reader thread
+const size_t EXTERNAL_SORT_MAX_FAN_IN = 64;
+
+
+inline void throw_errno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+
+inline void read_fully(int fd, void* data, size_t bytes, off_t offset)
+{
+    char* ptr = static_cast<char*>(data);
+
+    while (bytes > 0) {
+        ssize_t n = pread(fd, ptr, bytes, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw_errno("read");
+        }
+
+        ptr += n;
+        offset += n;
+        bytes -= n;
+    }
+}
+
+
+inline void write_fully(int fd, const void* data, size_t bytes)
+{
+    const char* ptr = static_cast<const char*>(data);
+
+    while (bytes > 0) {
+        ssize_t n = write(fd, ptr, bytes);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw_errno("write");
+        }
+
+        ptr += n;
+        bytes -= n;
+    }
+}
+
+
+// temporary file that is unlinked right after creation, so it disappears with the descriptor
+class TempFile {
+public:
+    explicit TempFile(const std::string& dir) :
+        _fd(-1)
+    {
+        std::string path = dir + "/external_sort_XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+
+        _fd = mkstemp(name.data());
+        if (_fd < 0) {
+            throw_errno("mkstemp");
+        }
+        unlink(name.data());
+    }
+
+    TempFile(TempFile&& that) noexcept :
+        _fd(that._fd)
+    {
+        that._fd = -1;
+    }
+
+    TempFile(const TempFile&) = delete;
+    TempFile& operator= (const TempFile&) = delete;
+
+   ~TempFile()
+    {
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    int fd() const
+    {
+        return _fd;
+    }
+
+private:
+    int _fd;
+};
+
+
+struct Run {
+    TempFile file;
+    size_t size;
+};
+
+
+// thread that runs the I/O of one RunReader or RunWriter, one job at a time: a run keeps the same thread
+// for its whole merge instead of starting one per block
+class IoThread {
+public:
+    IoThread() :
+        _stop(false),
+        _thread(&IoThread::_worker, this)
+    { }
+
+    IoThread(const IoThread&) = delete;
+    IoThread& operator= (const IoThread&) = delete;
+
+    // finishes the job in progress
+   ~IoThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+
+        _thread.join();
+    }
+
+    // the previous job must have been waited for
+    void start(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _job = std::move(job);
+        }
+        _cv.notify_all();
+    }
+
+    // waits for the last job started and rethrows its exception
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this] { return !_job; });
+
+        if (_error) {
+            std::exception_ptr error = _error;
+            _error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    // set while the job is queued or running
+    std::function<void()> _job;
+    std::exception_ptr _error;
+    bool _stop;
+    std::thread _thread;
+
+    void _worker()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (true) {
+            _cv.wait(lock, [this] { return _stop || _job; });
+
+            if (!_job) {
+                return;
+            }
+
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                _job();
+            }
+            catch(...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            _job = nullptr;
+            _error = error;
+            _cv.notify_all();
+        }
+    }
+};
+
+
+// sequential writer with two buffers: one is filled while the other is written in the background
+template <typename Record>
+class RunWriter {
+public:
+    RunWriter(int fd, size_t block) :
+        _fd(fd),
+        _front(std::max<size_t>(block, 1)),
+        _back(_front.size()),
+        _size(0),
+        _pending(false)
+    { }
+
+    void push(const Record& record)
+    {
+        _front[_size++] = record;
+
+        if (_size == _front.size()) {
+            _flush_front();
+        }
+    }
+
+    void finish()
+    {
+        _flush_front();
+        _wait();
+    }
+
+private:
+    int _fd;
+    std::vector<Record> _front;
+    std::vector<Record> _back;
+    size_t _size;
+    bool _pending;
+    // destroyed first, so a write in progress ends before its buffer goes away
+    IoThread _io;
+
+    void _wait()
+    {
+        if (_pending) {
+            _pending = false;
+            _io.wait();
+        }
+    }
+
+    void _flush_front()
+    {
+        _wait();
+        if (_size == 0) {
+            return;
+        }
+
+        std::swap(_front, _back);
+        int fd = _fd;
+        const Record* data = _back.data();
+        size_t bytes = _size * sizeof(Record);
+
+        _io.start([fd, data, bytes]() { write_fully(fd, data, bytes); });
+        _pending = true;
+        _size = 0;
+    }
+};
+
+
+// sequential reader of a run that reads the next block ahead while the current one is consumed
+template <typename Record>
+class RunReader {
+public:
+    RunReader(int fd, size_t size, size_t block) :
+        _fd(fd),
+        _size(size),
+        _requested(0),
+        _front(std::max<size_t>(block, 1)),
+        _back(_front.size()),
+        _front_size(0),
+        _pos(0),
+        _pending(0)
+    {
+        _request();
+        _advance_block();
+    }
+
+    // current record or nullptr when the run is exhausted
+    const Record* head() const
+    {
+        return _pos < _front_size ? &_front[_pos] : nullptr;
+    }
+
+    void next()
+    {
+        if (++_pos == _front_size) {
+            _advance_block();
+        }
+    }
+
+private:
+    int _fd;
+    size_t _size;
+    size_t _requested;
+    std::vector<Record> _front;
+    std::vector<Record> _back;
+    size_t _front_size;
+    size_t _pos;
+    // records being read into _back
+    size_t _pending;
+    // destroyed first, so a read in progress ends before its buffer goes away
+    IoThread _io;
+
+    void _request()
+    {
+        size_t count = std::min(_back.size(), _size - _requested);
+        if (count == 0) {
+            return;
+        }
+
+        int fd = _fd;
+        Record* data = _back.data();
+        off_t offset = _requested * sizeof(Record);
+
+        _io.start([fd, data, count, offset]() { read_fully(fd, data, count * sizeof(Record), offset); });
+        _pending = count;
+        _requested += count;
+    }
+
+    void _advance_block()
+    {
+        _pos = 0;
+        _front_size = 0;
+
+        if (_pending == 0) {
+            return;
+        }
+
+        size_t count = _pending;
+        _pending = 0;
+        _io.wait();
+
+        _front_size = count;
+
+        std::swap(_front, _back);
+        _request();
+    }
+};
+
+
+// tournament tree that keeps the loser of every match in the inner nodes, so replacing the winner
+// costs one comparison per level; exhausted sources lose to everything, ties go to the lower source index
+template <typename Record, typename Comparator>
+class LoserTree {
+public:
+    LoserTree(const std::vector<const Record*>& heads, Comparator cmp) :
+        _heads(heads),
+        _tree(std::max<size_t>(heads.size(), 1)),
+        _cmp(cmp)
+    {
+        _tree[0] = heads.size() > 1 ? _build(1) : 0;
+    }
+
+    size_t winner() const
+    {
+        return _tree[0];
+    }
+
+    const Record* top() const
+    {
+        return _heads[_tree[0]];
+    }
+
+    // replaces the head of the winning source and replays its matches up to the root
+    void replace_top(const Record* head)
+    {
+        size_t winner = _tree[0];
+        _heads[winner] = head;
+
+        for (size_t node = (winner + _heads.size()) / 2; node > 0; node /= 2) {
+            if (_beats(_tree[node], winner)) {
+                std::swap(_tree[node], winner);
+            }
+        }
+
+        _tree[0] = winner;
+    }
+
+private:
+    std::vector<const Record*> _heads;
+    std::vector<size_t> _tree;
+    Comparator _cmp;
+
+    bool _beats(size_t a, size_t b) const
+    {
+        if (_heads[a] == nullptr || _heads[b] == nullptr) {
+            return _heads[b] == nullptr && (_heads[a] != nullptr || a < b);
+        }
+
+        return _cmp(*_heads[a], *_heads[b]) || (!_cmp(*_heads[b], *_heads[a]) && a < b);
+    }
+
+    // inner nodes are 1..k-1, leaves are k..2k-1 in heap order; returns the winner of the subtree
+    size_t _build(size_t node)
+    {
+        size_t k = _heads.size();
+
+        if (node >= k) {
+            return node - k;
+        }
+
+        size_t left = _build(2 * node), right = _build(2 * node + 1);
+
+        if (_beats(left, right)) {
+            _tree[node] = right;
+            return left;
+        }
+
+        _tree[node] = left;
+        return right;
+    }
+};
+
+
+template <typename Record, typename Comparator>
+void merge_runs(std::vector<Run>& runs, size_t first, size_t last, int out_fd, Comparator cmp, size_t memory_budget)
+{
+    size_t k = last - first;
+    if (k == 0) {
+        return;
+    }
+
+    // k read buffers and one write buffer, each of them double buffered
+    size_t block = memory_budget / (2 * (k + 1) * sizeof(Record));
+
+    std::vector<std::unique_ptr<RunReader<Record>>> readers;
+    std::vector<const Record*> heads;
+
+    for (size_t i = first; i < last; i++) {
+        readers.emplace_back(new RunReader<Record>(runs[i].file.fd(), runs[i].size, block));
+        heads.push_back(readers.back()->head());
+    }
+
+    LoserTree<Record, Comparator> tree(heads, cmp);
+    RunWriter<Record> writer(out_fd, block);
+
+    while (tree.top() != nullptr) {
+        writer.push(*tree.top());
+
+        RunReader<Record>& reader = *readers[tree.winner()];
+        reader.next();
+        tree.replace_top(reader.head());
+    }
+
+    writer.finish();
+}
+
+
+// merges runs [first, last) into a new temporary run
+template <typename Record, typename Comparator>
+Run merge_to_run(std::vector<Run>& runs, size_t first, size_t last, Comparator cmp, size_t memory_budget,
+                 const std::string& temp_dir)
+{
+    size_t size = 0;
+    for (size_t i = first; i < last; i++) {
+        size += runs[i].size;
+    }
+
+    Run merged{TempFile(temp_dir), size};
+    merge_runs<Record>(runs, first, last, merged.file.fd(), cmp, memory_budget);
+
+    return merged;
+}
+
+
+// adds a run to level 0; a level that reaches fan_in runs is merged into one run of the next level, like a carry,
+// so the number of open runs stays logarithmic in the input size and every record is merged log_fan_in(runs) times
+template <typename Record, typename Comparator>
+void add_run(std::vector<std::vector<Run>>& levels, Run run, size_t fan_in, Comparator cmp, size_t memory_budget,
+             const std::string& temp_dir)
+{
+    if (levels.empty()) {
+        levels.emplace_back();
+    }
+    levels[0].push_back(std::move(run));
+
+    for (size_t level = 0; levels[level].size() == fan_in; level++) {
+        Run merged = merge_to_run<Record>(levels[level], 0, fan_in, cmp, memory_budget, temp_dir);
+        levels[level].clear();
+
+        if (level + 1 == levels.size()) {
+            levels.emplace_back();
+        }
+        levels[level + 1].push_back(std::move(merged));
+    }
+}
+
+
+// sorts the records of input_path into output_path using about memory_budget bytes of RAM;
+// Record must be trivially copyable and cmp a strict weak ordering, runs are kept in temp_dir
+template <typename Record, typename Comparator>
+void external_sort(const std::string& input_path, const std::string& output_path, Comparator cmp,
+                   size_t memory_budget, const std::string& temp_dir = "/tmp")
+{
+    static_assert(std::is_trivially_copyable<Record>::value, "external_sort() needs fixed-size POD records");
+
+    // merge_sort() needs a buffer as large as the chunk it sorts
+    size_t chunk_size = memory_budget / (2 * sizeof(Record));
+    if (chunk_size == 0) {
+        throw std::invalid_argument("memory budget is smaller than two records");
+    }
+
+    int in_fd = open(input_path.c_str(), O_RDONLY);
+    if (in_fd < 0) {
+        throw_errno("open " + input_path);
+    }
+
+    struct stat info;
+    if (fstat(in_fd, &info) < 0) {
+        close(in_fd);
+        throw_errno("stat " + input_path);
+    }
+
+    if (info.st_size % sizeof(Record) != 0) {
+        close(in_fd);
+        throw std::invalid_argument(input_path + " is not a whole number of records");
+    }
+
+    // runs are merged while the chunk buffer is still allocated, so early merges get the other half of the budget;
+    // every merged run needs two blocks of at least EXTERNAL_SORT_MIN_BLOCK bytes
+    size_t block_bytes = std::max(EXTERNAL_SORT_MIN_BLOCK, sizeof(Record));
+    size_t fan_in = std::min(EXTERNAL_SORT_MAX_FAN_IN, std::max<size_t>(3, memory_budget / (4 * block_bytes)) - 1);
+
+    size_t records = info.st_size / sizeof(Record);
+    std::vector<std::vector<Run>> levels;
+
+    if (records > 0) {
+        void* mapping = mmap(nullptr, records * sizeof(Record), PROT_READ, MAP_PRIVATE, in_fd, 0);
+        close(in_fd);
+
+        if (mapping == MAP_FAILED) {
+            throw_errno("mmap " + input_path);
+        }
+        madvise(mapping, records * sizeof(Record), MADV_SEQUENTIAL);
+
+        const Record* input = static_cast<const Record*>(mapping);
+
+        try {
+            std::vector<Record> chunk;
+
+            for (size_t begin = 0; begin < records; begin += chunk_size) {
+                size_t size = std::min(chunk_size, records - begin);
+
+                chunk.assign(input + begin, input + begin + size);
+                merge_sort(chunk.begin(), chunk.end(), cmp);
+
+                Run run{TempFile(temp_dir), size};
+                write_fully(run.file.fd(), chunk.data(), size * sizeof(Record));
+                add_run<Record>(levels, std::move(run), fan_in, cmp, memory_budget / 2, temp_dir);
+
+                // pages already sorted are not needed anymore, keep them from piling up in the resident set
+                size_t page = sysconf(_SC_PAGESIZE);
+                size_t consumed = (begin + size) * sizeof(Record) / page * page;
+                if (consumed > 0) {
+                    madvise(mapping, consumed, MADV_DONTNEED);
+                }
+            }
+        }
+        catch(...) {
+            munmap(mapping, records * sizeof(Record));
+            throw;
+        }
+
+        munmap(mapping, records * sizeof(Record));
+    }
+    else {
+        close(in_fd);
+    }
+
+    // higher levels hold earlier records
+    std::vector<Run> runs;
+    for (size_t level = levels.size(); level-- > 0; ) {
+        for (auto& run: levels[level]) {
+            runs.push_back(std::move(run));
+        }
+    }
+    levels.clear();
+
+    while (runs.size() > fan_in) {
+        std::vector<Run> merged;
+
+        for (size_t first = 0; first < runs.size(); first += fan_in) {
+            merged.push_back(merge_to_run<Record>(runs, first, std::min(first + fan_in, runs.size()), cmp,
+                                                  memory_budget, temp_dir));
+        }
+
+        runs = std::move(merged);
+    }
+
+    int out_fd = open(output_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        throw_errno("open " + output_path);
+    }
+
+    try {
+        merge_runs<Record>(runs, 0, runs.size(), out_fd, cmp, memory_budget);
+    }
+    catch(...) {
+        close(out_fd);
+        throw;
+    }
+
+    if (close(out_fd) < 0) {
+        throw_errno("close " + output_path);
+    }
+}
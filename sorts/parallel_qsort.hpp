@@ -0,0 +1,79 @@
+#pragma once
+
+#include <iterator>
+#include <type_traits>
+
+#include "qsort.hpp"
+#include "thread_pool.hpp"
+
+
+const size_t PARALLEL_QSORT_GRAIN = 1 << 14;
+
+
+// partitions the way pdqsort does: a range whose pivot equals its predecessor, the pivot of an earlier partition,
+// has all its keys equal to the pivot moved to the left and finished in one pass, so duplicates still split in parallel
+template <bool Branchless, typename RandomIterator, typename Comparator>
+void parallel_qsort(RandomIterator begin, RandomIterator end, Comparator cmp,
+                    size_t grain, size_t depth_limit, bool leftmost, TaskGroup& group)
+{
+    while (static_cast<size_t>(std::distance(begin, end)) > grain) {
+        // too many bad pivots, pdqsort copes with whatever pattern caused them
+        if (depth_limit == 0) {
+            break;
+        }
+        depth_limit--;
+
+        select_pivot_front(begin, end, cmp);
+
+        if (!leftmost && !cmp(*(begin - 1), *begin)) {
+            begin = partition_left(begin, end, cmp) + 1;
+            continue;
+        }
+
+        RandomIterator pivot = partition_right<Branchless>(begin, end, cmp).first;
+
+        // the larger side is handed to the pool where idle workers steal it
+        if (pivot - begin < end - pivot) {
+            group.run([=, &group]() { parallel_qsort<Branchless>(pivot + 1, end, cmp, grain, depth_limit, false, group); });
+            end = pivot;
+        }
+        else {
+            group.run([=, &group]() { parallel_qsort<Branchless>(begin, pivot, cmp, grain, depth_limit, leftmost, group); });
+            begin = pivot + 1;
+            leftmost = false;
+        }
+    }
+
+    qsort(begin, end, cmp);
+}
+
+
+// sorts on `threads` threads including the calling one; ranges up to `grain` elements are sorted serially.
+// The result does not depend on scheduling since every subrange is partitioned the same way whichever thread takes it
+template <typename RandomIterator, typename Comparator>
+void parallel_qsort(RandomIterator begin, RandomIterator end, Comparator cmp,
+                    size_t threads, size_t grain = PARALLEL_QSORT_GRAIN)
+{
+    typedef typename std::iterator_traits<RandomIterator>::value_type value_type;
+    const bool branchless = std::is_arithmetic<value_type>::value;
+
+    size_t size = std::distance(begin, end);
+
+    if (threads <= 1 || size <= grain) {
+        qsort(begin, end, cmp);
+        return;
+    }
+
+    ThreadPool pool(threads - 1);
+    TaskGroup group(pool);
+
+    // the partitions need a strict comparator, non-strict ones are turned into strict ones as in pdqsort()
+    if (cmp(*begin, *begin)) {
+        parallel_qsort<branchless>(begin, end, StrictComparator<Comparator>{cmp}, grain, introsort_depth_limit(size),
+                                   true, group);
+    }
+    else {
+        parallel_qsort<branchless>(begin, end, cmp, grain, introsort_depth_limit(size), true, group);
+    }
+    group.wait();
+}
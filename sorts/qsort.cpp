@@ -1,40 +1,8 @@
 #include <vector>
-#include <iterator>
 #include <functional>
 #include <iostream>
 
-
-template <typename RandomIterator, typename Comparator>
-RandomIterator partition(RandomIterator begin, RandomIterator end, Comparator cmp)
-{
-    RandomIterator left = begin, right = begin, pivot = end - 1;
-
-    while (right != pivot) {
-        if (cmp(*right, *pivot)) {
-            std::swap(*left, *right);
-            ++left;
-        }
-        ++right;
-    }
-
-    std::swap(*pivot, *left);
-
-	return left;
-}
-
-
-template <typename RandomIterator, typename Comparator>
-void qsort(RandomIterator begin, RandomIterator end, Comparator cmp)
-{
-    if (std::distance(begin, end) <= 1) {
-        return;
-    }
-
-    RandomIterator pivot = partition(begin, end, cmp);
-
-    qsort(begin, pivot, cmp);
-    qsort(pivot + 1, end, cmp);
-}
+#include "qsort.hpp"
 
 
 template <typename Comparator>
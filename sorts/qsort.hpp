@@ -0,0 +1,546 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "simd_sort.hpp"
+
+
+const size_t INSERTION_SORT_THRESHOLD = 16;
+const size_t NINTHER_THRESHOLD = 128;
+const size_t PARTIAL_INSERTION_SORT_LIMIT = 8;
+const size_t PARTITION_BLOCK_SIZE = 64;
+
+
+template <typename RandomIterator, typename Comparator>
+RandomIterator partition(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    RandomIterator left = begin, right = begin, pivot = end - 1;
+
+    while (right != pivot) {
+        if (cmp(*right, *pivot)) {
+            std::swap(*left, *right);
+            ++left;
+        }
+        ++right;
+    }
+
+    std::swap(*pivot, *left);
+
+    return left;
+}
+
+
+template <typename RandomIterator, typename Comparator>
+void insertion_sort(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    if (begin == end) {
+        return;
+    }
+
+    for (RandomIterator i = begin + 1; i != end; ++i) {
+        auto value = std::move(*i);
+        RandomIterator j = i;
+
+        for (; j != begin && cmp(value, *(j - 1)); --j) {
+            *j = std::move(*(j - 1));
+        }
+
+        *j = std::move(value);
+    }
+}
+
+
+template <typename RandomIterator, typename Comparator>
+void sift_down(RandomIterator begin, size_t pos, size_t size, Comparator cmp)
+{
+    auto value = std::move(*(begin + pos));
+
+    for (size_t child = 2 * pos + 1; child < size; child = 2 * pos + 1) {
+        if (child + 1 < size && cmp(*(begin + child), *(begin + child + 1))) {
+            child++;
+        }
+        if (!cmp(value, *(begin + child))) {
+            break;
+        }
+
+        *(begin + pos) = std::move(*(begin + child));
+        pos = child;
+    }
+
+    *(begin + pos) = std::move(value);
+}
+
+
+template <typename RandomIterator, typename Comparator>
+void heap_sort(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    size_t size = std::distance(begin, end);
+
+    for (size_t i = size / 2; i > 0; i--) {
+        sift_down(begin, i - 1, size, cmp);
+    }
+
+    for (size_t i = size; i > 1; i--) {
+        std::swap(*begin, *(begin + i - 1));
+        sift_down(begin, 0, i - 1, cmp);
+    }
+}
+
+
+// reorders *a, *b, *c so that *b holds the median of the three
+template <typename RandomIterator, typename Comparator>
+void sort3(RandomIterator a, RandomIterator b, RandomIterator c, Comparator cmp)
+{
+    if (cmp(*b, *a)) {
+        std::swap(*a, *b);
+    }
+    if (cmp(*c, *b)) {
+        std::swap(*b, *c);
+        if (cmp(*b, *a)) {
+            std::swap(*a, *b);
+        }
+    }
+}
+
+
+// moves the median of 3 (or the ninther for large ranges) to end - 1 where partition() expects the pivot
+template <typename RandomIterator, typename Comparator>
+void select_pivot(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    size_t size = std::distance(begin, end);
+    RandomIterator middle = begin + size / 2, last = end - 1;
+
+    if (size > NINTHER_THRESHOLD) {
+        size_t step = size / 8;
+
+        sort3(begin, begin + step, begin + 2 * step, cmp);
+        sort3(middle - step, middle, middle + step, cmp);
+        sort3(last - 2 * step, last - step, last, cmp);
+        sort3(begin + step, middle, last - step, cmp);
+    }
+    else {
+        sort3(begin, middle, last, cmp);
+    }
+
+    std::swap(*middle, *last);
+}
+
+
+inline size_t introsort_depth_limit(size_t size)
+{
+    size_t depth = 0;
+
+    for (; size > 1; size >>= 1) {
+        depth++;
+    }
+
+    return 2 * depth;
+}
+
+
+template <typename RandomIterator, typename Comparator>
+void introsort(RandomIterator begin, RandomIterator end, Comparator cmp, size_t depth_limit)
+{
+    while (static_cast<size_t>(std::distance(begin, end)) > INSERTION_SORT_THRESHOLD) {
+        if (static_cast<size_t>(std::distance(begin, end)) <= SIMD_SORT_BLOCK && simd_sort_block(begin, end, cmp)) {
+            return;
+        }
+        if (depth_limit == 0) {
+            heap_sort(begin, end, cmp);
+            return;
+        }
+        depth_limit--;
+
+        select_pivot(begin, end, cmp);
+        RandomIterator pivot = ::partition(begin, end, cmp);
+
+        // recursing into the smaller side keeps the stack depth logarithmic
+        if (pivot - begin < end - pivot) {
+            introsort(begin, pivot, cmp, depth_limit);
+            begin = pivot + 1;
+        }
+        else {
+            introsort(pivot + 1, end, cmp, depth_limit);
+            end = pivot;
+        }
+    }
+
+    if (!simd_sort_block(begin, end, cmp)) {
+        insertion_sort(begin, end, cmp);
+    }
+}
+
+
+template <typename RandomIterator, typename Comparator>
+void introsort(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    introsort(begin, end, cmp, introsort_depth_limit(std::distance(begin, end)));
+}
+
+
+// pattern-defeating quicksort; everything below expects a strict comparator, see StrictComparator
+
+// insertion sort for a range that is preceded by an element not greater than any of its elements
+template <typename RandomIterator, typename Comparator>
+void unguarded_insertion_sort(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    if (begin == end) {
+        return;
+    }
+
+    for (RandomIterator i = begin + 1; i != end; ++i) {
+        if (!cmp(*i, *(i - 1))) {
+            continue;
+        }
+
+        auto value = std::move(*i);
+        RandomIterator j = i;
+
+        do {
+            *j = std::move(*(j - 1));
+            --j;
+        } while (cmp(value, *(j - 1)));
+
+        *j = std::move(value);
+    }
+}
+
+
+// insertion sort that gives up after PARTIAL_INSERTION_SORT_LIMIT moves, returns true if the range got sorted
+template <typename RandomIterator, typename Comparator>
+bool partial_insertion_sort(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    if (begin == end) {
+        return true;
+    }
+
+    size_t moves = 0;
+
+    for (RandomIterator i = begin + 1; i != end; ++i) {
+        if (!cmp(*i, *(i - 1))) {
+            continue;
+        }
+
+        auto value = std::move(*i);
+        RandomIterator j = i;
+
+        do {
+            *j = std::move(*(j - 1));
+            --j;
+        } while (j != begin && cmp(value, *(j - 1)));
+
+        *j = std::move(value);
+        moves += i - j;
+
+        if (moves > PARTIAL_INSERTION_SORT_LIMIT) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// swaps pairs of misplaced elements found by partition_right(), using a cyclic permutation when the counts differ
+template <typename RandomIterator>
+void swap_offsets(RandomIterator left_base, RandomIterator right_base,
+                  const unsigned char* left_offsets, const unsigned char* right_offsets,
+                  size_t n, bool use_swaps)
+{
+    if (use_swaps) {
+        for (size_t i = 0; i < n; i++) {
+            std::iter_swap(left_base + left_offsets[i], right_base - right_offsets[i]);
+        }
+    }
+    else if (n > 0) {
+        RandomIterator left = left_base + left_offsets[0];
+        RandomIterator right = right_base - right_offsets[0];
+        auto tmp = std::move(*left);
+        *left = std::move(*right);
+
+        for (size_t i = 1; i < n; i++) {
+            left = left_base + left_offsets[i];
+            *right = std::move(*left);
+            right = right_base - right_offsets[i];
+            *left = std::move(*right);
+        }
+
+        *right = std::move(tmp);
+    }
+}
+
+
+// partitions [begin, end) around the pivot stored in *begin, elements equal to the pivot go to the right;
+// returns the final pivot position and whether the range was already partitioned.
+// Branchless variant records misplaced elements in offset blocks instead of branching on every comparison
+template <bool Branchless, typename RandomIterator, typename Comparator>
+std::pair<RandomIterator, bool> partition_right(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    auto pivot = std::move(*begin);
+    RandomIterator first = begin, last = end;
+
+    // pivot selection guarantees an element not less than the pivot at the end of the range
+    while (cmp(*++first, pivot));
+
+    if (first - 1 == begin) {
+        while (first < last && !cmp(*--last, pivot));
+    }
+    else {
+        while (!cmp(*--last, pivot));
+    }
+
+    bool already_partitioned = first >= last;
+
+    if (!Branchless) {
+        while (first < last) {
+            std::iter_swap(first, last);
+            while (cmp(*++first, pivot));
+            while (!cmp(*--last, pivot));
+        }
+    }
+    else if (!already_partitioned) {
+        std::iter_swap(first, last);
+        ++first;
+
+        unsigned char left_offsets[PARTITION_BLOCK_SIZE], right_offsets[PARTITION_BLOCK_SIZE];
+        RandomIterator left_base = first, right_base = last;
+        size_t left_count = 0, right_count = 0, left_start = 0, right_start = 0;
+
+        while (first < last) {
+            size_t unknown = last - first;
+            size_t left_split = left_count == 0 ? (right_count == 0 ? unknown / 2 : unknown) : 0;
+            size_t right_split = right_count == 0 ? unknown - left_split : 0;
+
+            left_split = std::min(left_split, PARTITION_BLOCK_SIZE);
+            right_split = std::min(right_split, PARTITION_BLOCK_SIZE);
+
+            for (size_t i = 0; i < left_split; i++) {
+                left_offsets[left_count] = static_cast<unsigned char>(i);
+                left_count += !cmp(*first, pivot);
+                ++first;
+            }
+            for (size_t i = 0; i < right_split; i++) {
+                right_offsets[right_count] = static_cast<unsigned char>(i + 1);
+                right_count += cmp(*--last, pivot);
+            }
+
+            size_t n = std::min(left_count, right_count);
+            swap_offsets(left_base, right_base, left_offsets + left_start, right_offsets + right_start,
+                         n, left_count == right_count);
+
+            left_count -= n; right_count -= n;
+            left_start += n; right_start += n;
+
+            if (left_count == 0) {
+                left_start = 0;
+                left_base = first;
+            }
+            if (right_count == 0) {
+                right_start = 0;
+                right_base = last;
+            }
+        }
+
+        // one of the blocks may still hold misplaced elements, move them next to the boundary
+        if (left_count) {
+            while (left_count--) {
+                std::iter_swap(left_base + left_offsets[left_start + left_count], --last);
+            }
+            first = last;
+        }
+        if (right_count) {
+            while (right_count--) {
+                std::iter_swap(right_base - right_offsets[right_start + right_count], first);
+                ++first;
+            }
+        }
+    }
+
+    RandomIterator pivot_pos = first - 1;
+    *begin = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+
+    return std::make_pair(pivot_pos, already_partitioned);
+}
+
+
+// partitions [begin, end) around the pivot stored in *begin, elements equal to the pivot go to the left;
+// used when the pivot equals the predecessor of the range, so that whole run of equal keys is done in one pass
+template <typename RandomIterator, typename Comparator>
+RandomIterator partition_left(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    auto pivot = std::move(*begin);
+    RandomIterator first = begin, last = end;
+
+    while (cmp(pivot, *--last));
+
+    if (last + 1 == end) {
+        while (first < last && !cmp(pivot, *++first));
+    }
+    else {
+        while (!cmp(pivot, *++first));
+    }
+
+    while (first < last) {
+        std::iter_swap(first, last);
+        while (cmp(pivot, *--last));
+        while (!cmp(pivot, *++first));
+    }
+
+    *begin = std::move(*last);
+    *last = std::move(pivot);
+
+    return last;
+}
+
+
+// breaks patterns that made the last partition highly unbalanced
+template <typename RandomIterator>
+void shuffle_partition(RandomIterator begin, RandomIterator end)
+{
+    size_t size = std::distance(begin, end);
+
+    if (size < INSERTION_SORT_THRESHOLD) {
+        return;
+    }
+
+    std::iter_swap(begin, begin + size / 4);
+    std::iter_swap(end - 1, end - size / 4);
+
+    if (size > NINTHER_THRESHOLD) {
+        std::iter_swap(begin + 1, begin + (size / 4 + 1));
+        std::iter_swap(begin + 2, begin + (size / 4 + 2));
+        std::iter_swap(end - 2, end - (size / 4 + 1));
+        std::iter_swap(end - 3, end - (size / 4 + 2));
+    }
+}
+
+
+// pivot selection of pdqsort: the pivot ends up in *begin, the largest of the samples at the end of the range
+template <typename RandomIterator, typename Comparator>
+void select_pivot_front(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    size_t size = std::distance(begin, end);
+    size_t half = size / 2;
+
+    if (size > NINTHER_THRESHOLD) {
+        sort3(begin, begin + half, end - 1, cmp);
+        sort3(begin + 1, begin + (half - 1), end - 2, cmp);
+        sort3(begin + 2, begin + (half + 1), end - 3, cmp);
+        sort3(begin + (half - 1), begin + half, begin + (half + 1), cmp);
+        std::iter_swap(begin, begin + half);
+    }
+    else {
+        sort3(begin + half, begin, end - 1, cmp);
+    }
+}
+
+
+template <bool Branchless, typename RandomIterator, typename Comparator>
+void pdqsort(RandomIterator begin, RandomIterator end, Comparator cmp, size_t bad_allowed, bool leftmost)
+{
+    while (true) {
+        size_t size = std::distance(begin, end);
+
+        if (size <= SIMD_SORT_BLOCK && simd_sort_block(begin, end, cmp)) {
+            return;
+        }
+
+        if (size < INSERTION_SORT_THRESHOLD) {
+            if (leftmost) {
+                insertion_sort(begin, end, cmp);
+            }
+            else {
+                unguarded_insertion_sort(begin, end, cmp);
+            }
+            return;
+        }
+
+        select_pivot_front(begin, end, cmp);
+
+        // the predecessor is not greater than anything in the range, so if it equals the pivot
+        // the range contains many equal keys; put them all to the left and skip them
+        if (!leftmost && !cmp(*(begin - 1), *begin)) {
+            begin = partition_left(begin, end, cmp) + 1;
+            continue;
+        }
+
+        auto result = partition_right<Branchless>(begin, end, cmp);
+        RandomIterator pivot = result.first;
+        bool already_partitioned = result.second;
+
+        size_t left_size = pivot - begin;
+        size_t right_size = end - (pivot + 1);
+
+        if (left_size < size / 8 || right_size < size / 8) {
+            if (--bad_allowed == 0) {
+                heap_sort(begin, end, cmp);
+                return;
+            }
+
+            shuffle_partition(begin, pivot);
+            shuffle_partition(pivot + 1, end);
+        }
+        else if (already_partitioned && partial_insertion_sort(begin, pivot, cmp)
+                                     && partial_insertion_sort(pivot + 1, end, cmp)) {
+            return;
+        }
+
+        if (left_size < right_size) {
+            pdqsort<Branchless>(begin, pivot, cmp, bad_allowed, leftmost);
+            begin = pivot + 1;
+            leftmost = false;
+        }
+        else {
+            pdqsort<Branchless>(pivot + 1, end, cmp, bad_allowed, false);
+            end = pivot;
+        }
+    }
+}
+
+
+// turns a non-strict comparator such as std::less_equal into the strict one pdqsort relies on
+template <typename Comparator>
+struct StrictComparator {
+    Comparator cmp;
+
+    template <typename T>
+    bool operator() (const T& a, const T& b) const
+    {
+        return !cmp(b, a);
+    }
+};
+
+template <typename Comparator, typename T>
+struct is_ascending_comparator<StrictComparator<Comparator>, T> : is_ascending_comparator<Comparator, T> { };
+
+
+template <typename RandomIterator, typename Comparator>
+void pdqsort(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    typedef typename std::iterator_traits<RandomIterator>::value_type value_type;
+    const bool branchless = std::is_arithmetic<value_type>::value;
+
+    size_t size = std::distance(begin, end);
+
+    if (size <= 1) {
+        return;
+    }
+
+    if (cmp(*begin, *begin)) {
+        pdqsort<branchless>(begin, end, StrictComparator<Comparator>{cmp}, introsort_depth_limit(size) / 2, true);
+    }
+    else {
+        pdqsort<branchless>(begin, end, cmp, introsort_depth_limit(size) / 2, true);
+    }
+}
+
+
+template <typename RandomIterator, typename Comparator>
+void qsort(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    pdqsort(begin, end, cmp);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "qsort.hpp"
+
+
+const size_t RADIX_SORT_THRESHOLD = 64;
+
+
+// maps a key to an unsigned integer whose natural order matches the order of the keys
+template <typename Key, typename Enable = void>
+struct RadixKey;
+
+template <typename Key>
+struct RadixKey<Key, typename std::enable_if<std::is_integral<Key>::value>::type> {
+    typedef typename std::make_unsigned<Key>::type unsigned_type;
+
+    static unsigned_type encode(Key key)
+    {
+        unsigned_type bits = static_cast<unsigned_type>(key);
+
+        // flipping the sign bit puts negative numbers before positive ones
+        if (std::is_signed<Key>::value) {
+            bits ^= unsigned_type(1) << (8 * sizeof(Key) - 1);
+        }
+
+        return bits;
+    }
+};
+
+template <typename Key>
+struct RadixKey<Key, typename std::enable_if<std::is_floating_point<Key>::value>::type> {
+    typedef typename std::conditional<sizeof(Key) == 4, uint32_t, uint64_t>::type unsigned_type;
+
+    static_assert(sizeof(Key) == sizeof(unsigned_type), "only IEEE single and double precision keys are supported");
+
+    static unsigned_type encode(Key key)
+    {
+        unsigned_type bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+
+        // negative numbers are stored as sign and magnitude, so their order has to be reversed
+        const unsigned_type sign = unsigned_type(1) << (8 * sizeof(Key) - 1);
+        return (bits & sign) ? ~bits : bits | sign;
+    }
+};
+
+
+template <typename T>
+struct IdentityKey {
+    const T& operator() (const T& value) const
+    {
+        return value;
+    }
+};
+
+
+// stable LSD radix sort by 8-bit digits of key(element); key must return an integral or floating point value.
+// Histograms of all digits are built in one pass over the data and digits that are equal for every element are skipped
+template <typename RandomIt, typename KeyExtractor>
+void radix_sort(RandomIt begin, RandomIt end, KeyExtractor key)
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+    typedef typename std::decay<decltype(key(*begin))>::type key_type;
+    typedef RadixKey<key_type> radix_key;
+    typedef typename radix_key::unsigned_type unsigned_type;
+
+    const size_t passes = sizeof(unsigned_type);
+    size_t size = std::distance(begin, end);
+
+    if (size <= RADIX_SORT_THRESHOLD) {
+        insertion_sort(begin, end, [&key](const value_type& a, const value_type& b) {
+            return radix_key::encode(key(a)) < radix_key::encode(key(b));
+        });
+        return;
+    }
+
+    std::vector<std::array<size_t, 256>> counts(passes);
+    for (auto& count: counts) {
+        count.fill(0);
+    }
+
+    for (RandomIt it = begin; it != end; ++it) {
+        unsigned_type bits = radix_key::encode(key(*it));
+        for (size_t pass = 0; pass < passes; pass++) {
+            counts[pass][(bits >> (8 * pass)) & 0xff]++;
+        }
+    }
+
+    std::vector<value_type> buffer(size);
+    bool in_buffer = false;
+
+    for (size_t pass = 0; pass < passes; pass++) {
+        auto& count = counts[pass];
+
+        if (*std::max_element(count.begin(), count.end()) == size) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (auto& bucket: count) {
+            size_t bucket_size = bucket;
+            bucket = offset;
+            offset += bucket_size;
+        }
+
+        if (in_buffer) {
+            for (auto it = buffer.begin(); it != buffer.end(); ++it) {
+                size_t digit = (radix_key::encode(key(*it)) >> (8 * pass)) & 0xff;
+                *(begin + count[digit]++) = std::move(*it);
+            }
+        }
+        else {
+            for (RandomIt it = begin; it != end; ++it) {
+                size_t digit = (radix_key::encode(key(*it)) >> (8 * pass)) & 0xff;
+                buffer[count[digit]++] = std::move(*it);
+            }
+        }
+
+        in_buffer = !in_buffer;
+    }
+
+    if (in_buffer) {
+        std::move(buffer.begin(), buffer.end(), begin);
+    }
+}
+
+
+template <typename RandomIt>
+void radix_sort(RandomIt begin, RandomIt end)
+{
+    radix_sort(begin, end, IdentityKey<typename std::iterator_traits<RandomIt>::value_type>());
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "qsort.hpp"
+#include "thread_pool.hpp"
+
+
+const size_t SAMPLE_SORT_OVERSAMPLING = 16;
+const size_t SAMPLE_SORT_MAX_BUCKETS = 256;
+const size_t SAMPLE_SORT_GRAIN = 1 << 16;
+
+
+// splitters stored as an implicit binary search tree (children of node i are 2i and 2i + 1),
+// so finding the bucket of an element is log2(buckets) comparisons without branches.
+// With equal_buckets every splitter also gets a bucket of its own for the keys equal to it: such a bucket needs
+// no sorting, so inputs with few distinct keys still split into many buckets instead of piling up in one
+template <typename T, typename Comparator>
+class SplitterTree {
+public:
+    SplitterTree(const std::vector<T>& splitters, Comparator cmp, bool equal_buckets) :
+        _tree(splitters.size() + 1),
+        _splitters(splitters),
+        _levels(0),
+        _cmp(cmp),
+        _equal_buckets(equal_buckets)
+    {
+        for (size_t n = splitters.size() + 1; n > 1; n /= 2) {
+            _levels++;
+        }
+
+        _build(splitters, 1, 0, splitters.size());
+    }
+
+    size_t buckets() const
+    {
+        return _equal_buckets ? 2 * _tree.size() - 1 : _tree.size();
+    }
+
+    // the odd buckets hold the keys equal to a splitter
+    bool is_equal_bucket(size_t bucket) const
+    {
+        return _equal_buckets && bucket % 2 == 1;
+    }
+
+    size_t bucket(const T& value) const
+    {
+        size_t node = 1;
+
+        for (size_t level = 0; level < _levels; level++) {
+            node = 2 * node + static_cast<size_t>(_cmp(_tree[node], value));
+        }
+
+        size_t bucket = node - _tree.size();
+
+        if (!_equal_buckets) {
+            return bucket;
+        }
+
+        // the value is not greater than the splitter of its bucket, so it is equal unless it is less
+        return 2 * bucket + static_cast<size_t>(bucket < _splitters.size() && !_cmp(value, _splitters[bucket]));
+    }
+
+private:
+    std::vector<T> _tree;
+    std::vector<T> _splitters;
+    size_t _levels;
+    Comparator _cmp;
+    bool _equal_buckets;
+
+    void _build(const std::vector<T>& splitters, size_t node, size_t begin, size_t end)
+    {
+        if (begin >= end) {
+            return;
+        }
+
+        size_t middle = begin + (end - begin) / 2;
+        _tree[node] = splitters[middle];
+
+        _build(splitters, 2 * node, begin, middle);
+        _build(splitters, 2 * node + 1, middle + 1, end);
+    }
+};
+
+
+template <typename Function>
+void parallel_for(ThreadPool& pool, size_t n, Function function)
+{
+    TaskGroup group(pool);
+
+    for (size_t i = 0; i < n; i++) {
+        group.run([=]() { function(i); });
+    }
+
+    group.wait();
+}
+
+
+// parallel sample sort on `threads` threads including the calling one: every thread classifies its own chunk
+// against oversampled splitters, the chunks are scattered into one buffer by per-thread histograms
+// and every bucket but the equal ones is sorted with qsort(). The sample is taken with a fixed seed, so the result is deterministic
+template <typename RandomIt, typename Comparator>
+void sample_sort_strict(RandomIt begin, RandomIt end, Comparator cmp, size_t threads)
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+
+    size_t size = std::distance(begin, end);
+
+    size_t buckets = 2;
+    while (buckets < 4 * threads && buckets < SAMPLE_SORT_MAX_BUCKETS) {
+        buckets *= 2;
+    }
+
+    std::vector<value_type> sample;
+    std::mt19937_64 random(size);
+
+    sample.reserve(SAMPLE_SORT_OVERSAMPLING * buckets);
+    for (size_t i = 0; i < SAMPLE_SORT_OVERSAMPLING * buckets; i++) {
+        sample.push_back(*(begin + random() % size));
+    }
+    qsort(sample.begin(), sample.end(), cmp);
+
+    std::vector<value_type> splitters;
+    for (size_t i = 1; i < buckets; i++) {
+        splitters.push_back(sample[i * SAMPLE_SORT_OVERSAMPLING]);
+    }
+
+    // repeated splitters mean heavy keys: every distinct splitter gets an equal bucket, the tree still needs
+    // 2^k - 1 splitters (padded with the largest one) and the bucket of an element has to fit in a byte
+    auto equal = [cmp](const value_type& a, const value_type& b) { return !cmp(a, b); };
+    bool equal_buckets = std::adjacent_find(splitters.begin(), splitters.end(), equal) != splitters.end();
+
+    if (equal_buckets) {
+        splitters.erase(std::unique(splitters.begin(), splitters.end(), equal), splitters.end());
+
+        while (splitters.size() + 1 > SAMPLE_SORT_MAX_BUCKETS / 2) {
+            for (size_t i = 0; 2 * i + 1 < splitters.size(); i++) {
+                splitters[i] = splitters[2 * i + 1];
+            }
+            splitters.resize(splitters.size() / 2);
+        }
+
+        size_t tree_buckets = 2;
+        while (tree_buckets < splitters.size() + 1) {
+            tree_buckets *= 2;
+        }
+        splitters.resize(tree_buckets - 1, splitters.back());
+    }
+
+    SplitterTree<value_type, Comparator> tree(splitters, cmp, equal_buckets);
+    ThreadPool pool(threads - 1);
+
+    buckets = tree.buckets();
+
+    // bucket of every element, so the scatter pass does not have to compare again
+    std::vector<unsigned char> oracle(size);
+    std::vector<std::vector<size_t>> offsets(threads, std::vector<size_t>(buckets, 0));
+
+    parallel_for(pool, threads, [&, begin](size_t t) {
+        for (size_t i = size * t / threads; i < size * (t + 1) / threads; i++) {
+            size_t bucket = tree.bucket(*(begin + i));
+            oracle[i] = static_cast<unsigned char>(bucket);
+            offsets[t][bucket]++;
+        }
+    });
+
+    std::vector<size_t> bucket_begin(buckets + 1, 0);
+    for (size_t b = 0, offset = 0; b < buckets; b++) {
+        bucket_begin[b] = offset;
+        for (size_t t = 0; t < threads; t++) {
+            size_t count = offsets[t][b];
+            offsets[t][b] = offset;
+            offset += count;
+        }
+    }
+    bucket_begin[buckets] = size;
+
+    std::vector<value_type> buffer(size);
+
+    parallel_for(pool, threads, [&, begin](size_t t) {
+        std::vector<size_t>& offset = offsets[t];
+        for (size_t i = size * t / threads; i < size * (t + 1) / threads; i++) {
+            buffer[offset[oracle[i]]++] = std::move(*(begin + i));
+        }
+    });
+
+    parallel_for(pool, buckets, [&, begin](size_t b) {
+        auto first = buffer.begin() + bucket_begin[b], last = buffer.begin() + bucket_begin[b + 1];
+
+        if (!tree.is_equal_bucket(b)) {
+            qsort(first, last, cmp);
+        }
+        std::move(first, last, begin + bucket_begin[b]);
+    });
+}
+
+
+// the splitter tree and the equal buckets need a strict comparator, non-strict ones are made strict as in pdqsort()
+template <typename RandomIt, typename Comparator>
+void sample_sort(RandomIt begin, RandomIt end, Comparator cmp, size_t threads)
+{
+    size_t size = std::distance(begin, end);
+
+    if (threads <= 1 || size <= SAMPLE_SORT_GRAIN) {
+        qsort(begin, end, cmp);
+        return;
+    }
+
+    if (cmp(*begin, *begin)) {
+        sample_sort_strict(begin, end, StrictComparator<Comparator>{cmp}, threads);
+    }
+    else {
+        sample_sort_strict(begin, end, cmp, threads);
+    }
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "select.hpp"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+std::vector<std::pair<std::string, std::vector<int>>> inputs(size_t size)
+{
+    std::mt19937 random(size);
+    std::vector<int> shuffled(size), sorted(size), reversed(size), equal(size, 7), few(size), pipe(size);
+
+    for (size_t i = 0; i < size; i++) {
+        shuffled[i] = random();
+        sorted[i] = i;
+        reversed[i] = size - i;
+        few[i] = random() % 3;
+        pipe[i] = std::min(i, size - i);
+    }
+
+    return {
+        {"random", shuffled},
+        {"sorted", sorted},
+        {"reversed", reversed},
+        {"equal", equal},
+        {"few distinct", few},
+        {"organ pipe", pipe},
+    };
+}
+
+
+// `cmp` may be non-strict, `strict` orders the same way and is what std::sort gets for the reference
+template <typename Comparator, typename Strict>
+void test(const std::string& cmp_name, Comparator cmp, Strict strict)
+{
+    for (size_t size: {0, 1, 2, 10, 17, 100, 1000, 5000, 100000}) {
+        for (auto& input: inputs(size)) {
+            std::string name = cmp_name + " " + input.first + " of " + std::to_string(size);
+
+            std::vector<int> expected = input.second;
+            std::sort(expected.begin(), expected.end(), strict);
+
+            for (size_t nth: {size_t(0), size / 3, size / 2, size - 1, size}) {
+                if (nth > size) {
+                    continue;
+                }
+
+                std::vector<int> v = input.second;
+                select_nth(v.begin(), v.begin() + nth, v.end(), cmp);
+
+                if (nth == size) {
+                    continue;
+                }
+
+                bool placed = v[nth] == expected[nth];
+                for (size_t i = 0; i < nth; i++) {
+                    placed = placed && !strict(v[nth], v[i]);
+                }
+                for (size_t i = nth + 1; i < size; i++) {
+                    placed = placed && !strict(v[i], v[nth]);
+                }
+                check(placed, name + ": select_nth of " + std::to_string(nth));
+
+                std::sort(v.begin(), v.end(), strict);
+                check(v == expected, name + ": select_nth keeps the elements");
+
+                // the median of medians pivots that select_nth falls back to when partitions remove little
+                v = input.second;
+                select_nth_strict(v.begin(), v.begin() + nth, v.end(), strict, true);
+                check(v[nth] == expected[nth], name + ": select_nth with guaranteed pivots of " + std::to_string(nth));
+            }
+
+            for (size_t k: {size_t(0), size_t(1), size_t(5), size / 100, size / 2, size}) {
+                std::vector<int> prefix(expected.begin(), expected.begin() + std::min(k, size));
+
+                std::vector<int> v = input.second;
+                partial_qsort(v.begin(), v.begin() + std::min(k, size), v.end(), cmp);
+                check(std::equal(prefix.begin(), prefix.end(), v.begin()), name + ": partial_qsort of " + std::to_string(k));
+
+                check(top_k(input.second.begin(), input.second.end(), k, cmp) == prefix,
+                      name + ": top_k of " + std::to_string(k));
+
+                std::list<int> list(input.second.begin(), input.second.end());
+                check(top_k(list.begin(), list.end(), k, cmp) == prefix,
+                      name + ": top_k of " + std::to_string(k) + " through a bidirectional iterator");
+            }
+
+            check(top_k(input.second.begin(), input.second.end(), size + 10, cmp) == expected,
+                  name + ": top_k of more than size");
+        }
+    }
+}
+
+
+int main()
+{
+    test("less", std::less<int>(), std::less<int>());
+    test("less or equal", std::less_equal<int>(), std::less<int>());
+    test("greater", std::greater<int>(), std::greater<int>());
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "qsort.hpp"
+
+
+const size_t FLOYD_RIVEST_THRESHOLD = 600;
+const size_t MEDIAN_GROUP_SIZE = 5;
+// top_k() and partial_qsort() keep a bounded heap instead of selecting when k * HEAP_SELECT_RATIO <= n
+const size_t HEAP_SELECT_RATIO = 64;
+
+
+template <typename RandomIterator, typename Comparator>
+void select_nth_strict(RandomIterator begin, RandomIterator nth, RandomIterator end, Comparator cmp, bool guaranteed);
+
+
+// median of medians of groups of 5, guarantees that at least 30% of the elements are on each side of it
+template <typename RandomIterator, typename Comparator>
+RandomIterator median_of_medians(RandomIterator begin, RandomIterator end, Comparator cmp)
+{
+    size_t size = std::distance(begin, end);
+    RandomIterator medians = begin;
+
+    for (size_t i = 0; i < size; i += MEDIAN_GROUP_SIZE) {
+        RandomIterator group = begin + i;
+        size_t group_size = std::min(MEDIAN_GROUP_SIZE, size - i);
+
+        insertion_sort(group, group + group_size, cmp);
+        std::iter_swap(medians++, group + group_size / 2);
+    }
+
+    RandomIterator median = begin + std::distance(begin, medians) / 2;
+    select_nth_strict(begin, median, medians, cmp, true);
+
+    return median;
+}
+
+
+// Floyd-Rivest: selects the nth element of a small sample around the expected position of nth,
+// which makes a pivot that splits off almost all elements on the wrong side of nth
+template <typename RandomIterator, typename Comparator>
+void floyd_rivest_pivot(RandomIterator begin, RandomIterator nth, RandomIterator end, Comparator cmp)
+{
+    double n = static_cast<double>(std::distance(begin, end));
+    double i = static_cast<double>(std::distance(begin, nth));
+    double z = std::log(n);
+    double s = 0.5 * std::exp(2 * z / 3);
+    double sd = 0.5 * std::sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1 : 1);
+
+    size_t left = static_cast<size_t>(std::max(0.0, std::min(i, i - i * s / n + sd)));
+    size_t right = static_cast<size_t>(std::min(n, std::max(i + 1, i + (n - i) * s / n + sd + 1)));
+
+    select_nth_strict(begin + left, nth, begin + right, cmp, false);
+}
+
+
+template <typename RandomIterator, typename Comparator>
+void select_nth_strict(RandomIterator begin, RandomIterator nth, RandomIterator end, Comparator cmp, bool guaranteed)
+{
+    size_t budget = introsort_depth_limit(std::distance(begin, end));
+
+    while (static_cast<size_t>(std::distance(begin, end)) > INSERTION_SORT_THRESHOLD) {
+        // too many partitions that removed little, switch to pivots with a worst case guarantee
+        if (budget == 0) {
+            guaranteed = true;
+        }
+        else {
+            budget--;
+        }
+
+        if (guaranteed) {
+            std::iter_swap(median_of_medians(begin, end, cmp), end - 1);
+        }
+        else if (static_cast<size_t>(std::distance(begin, end)) > FLOYD_RIVEST_THRESHOLD) {
+            floyd_rivest_pivot(begin, nth, end, cmp);
+            std::iter_swap(nth, end - 1);
+        }
+        else {
+            select_pivot(begin, end, cmp);
+        }
+
+        RandomIterator pivot = ::partition(begin, end, cmp);
+
+        if (nth == pivot) {
+            return;
+        }
+        if (nth < pivot) {
+            end = pivot;
+            continue;
+        }
+
+        begin = pivot + 1;
+
+        // keys equal to the pivot all went to the right, skip them so that duplicates cannot stall the loop
+        if (guaranteed) {
+            begin = std::partition(begin, end, [&](const typename std::iterator_traits<RandomIterator>::value_type& x) {
+                return !cmp(*pivot, x);
+            });
+            if (nth < begin) {
+                return;
+            }
+        }
+    }
+
+    insertion_sort(begin, end, cmp);
+}
+
+
+// reorders [begin, end) so that *nth is the element that would be there after sorting, no element
+// of [begin, nth) goes after it and none of [nth + 1, end) goes before it; expected O(n), worst case O(n) too
+template <typename RandomIterator, typename Comparator>
+void select_nth(RandomIterator begin, RandomIterator nth, RandomIterator end, Comparator cmp)
+{
+    if (std::distance(begin, end) <= 1 || nth == end) {
+        return;
+    }
+
+    if (cmp(*begin, *begin)) {
+        select_nth_strict(begin, nth, end, StrictComparator<Comparator>{cmp}, false);
+    }
+    else {
+        select_nth_strict(begin, nth, end, cmp, false);
+    }
+}
+
+
+// keeps the `k` first elements of [begin, end) in a max-heap at [heap, heap + k)
+template <typename RandomIterator, typename InputIterator, typename Comparator>
+void heap_select(RandomIterator heap, size_t k, InputIterator begin, InputIterator end, Comparator cmp)
+{
+    for (; begin != end; ++begin) {
+        if (cmp(*begin, *heap)) {
+            *heap = *begin;
+            sift_down(heap, 0, k, cmp);
+        }
+    }
+}
+
+
+// sorts the first middle - begin elements of [begin, end) into place, the rest is left in unspecified order
+template <typename RandomIterator, typename Comparator>
+void partial_qsort(RandomIterator begin, RandomIterator middle, RandomIterator end, Comparator cmp)
+{
+    size_t size = std::distance(begin, end), k = std::distance(begin, middle);
+
+    if (k == 0) {
+        return;
+    }
+
+    if (k * HEAP_SELECT_RATIO <= size) {
+        for (size_t i = k / 2; i > 0; i--) {
+            sift_down(begin, i - 1, k, cmp);
+        }
+        for (RandomIterator it = middle; it != end; ++it) {
+            if (cmp(*it, *begin)) {
+                std::iter_swap(it, begin);
+                sift_down(begin, 0, k, cmp);
+            }
+        }
+        heap_sort(begin, middle, cmp);
+        return;
+    }
+
+    select_nth(begin, middle - 1, end, cmp);
+    qsort(begin, middle, cmp);
+}
+
+
+template <typename InputIterator, typename Comparator>
+std::vector<typename std::iterator_traits<InputIterator>::value_type>
+top_k(InputIterator begin, InputIterator end, size_t k, Comparator cmp, std::input_iterator_tag)
+{
+    typedef typename std::iterator_traits<InputIterator>::value_type value_type;
+
+    std::vector<value_type> heap;
+    heap.reserve(k);
+
+    for (; begin != end && heap.size() < k; ++begin) {
+        heap.push_back(*begin);
+    }
+    for (size_t i = heap.size() / 2; i > 0; i--) {
+        sift_down(heap.begin(), i - 1, heap.size(), cmp);
+    }
+
+    if (!heap.empty()) {
+        heap_select(heap.begin(), heap.size(), begin, end, cmp);
+    }
+    heap_sort(heap.begin(), heap.end(), cmp);
+
+    return heap;
+}
+
+
+template <typename RandomIterator, typename Comparator>
+std::vector<typename std::iterator_traits<RandomIterator>::value_type>
+top_k(RandomIterator begin, RandomIterator end, size_t k, Comparator cmp, std::random_access_iterator_tag)
+{
+    typedef typename std::iterator_traits<RandomIterator>::value_type value_type;
+
+    size_t size = std::distance(begin, end);
+
+    if (k * HEAP_SELECT_RATIO <= size) {
+        return top_k(begin, end, k, cmp, std::input_iterator_tag());
+    }
+
+    std::vector<value_type> result(begin, end);
+    k = std::min(k, size);
+
+    if (k < size) {
+        select_nth(result.begin(), result.begin() + k, result.end(), cmp);
+        result.resize(k);
+    }
+    qsort(result.begin(), result.end(), cmp);
+
+    return result;
+}
+
+
+// the k first elements of [begin, end) in sorted order (pass std::greater for the k largest);
+// small k streams the input through a bounded heap, so any input iterator works
+template <typename InputIterator, typename Comparator>
+std::vector<typename std::iterator_traits<InputIterator>::value_type>
+top_k(InputIterator begin, InputIterator end, size_t k, Comparator cmp)
+{
+    return top_k(begin, end, k, cmp, typename std::iterator_traits<InputIterator>::iterator_category());
+}
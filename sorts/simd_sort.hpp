@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SIMD_SORT_AVX2
+#include <immintrin.h>
+#endif
+
+
+// AVX2 sorting network kernels used as the base case of the sorts when the element type is int32_t or float,
+// the range is contiguous and the comparator sorts ascending; the CPU is checked at runtime.
+// The kernels rebuild elements from their keys and do not keep the order of equal ones, so stable sorts
+// use them through simd_stable_sort_block() and simd_stable_merge(), only for types whose equal elements are identical
+
+const size_t SIMD_SORT_BLOCK = 64;
+
+
+template <typename Comparator, typename T>
+struct is_ascending_comparator : std::false_type { };
+
+template <typename T>
+struct is_ascending_comparator<std::less<T>, T> : std::true_type { };
+
+template <typename T>
+struct is_ascending_comparator<std::less_equal<T>, T> : std::true_type { };
+
+template <typename T>
+struct is_ascending_comparator<std::less<void>, T> : std::true_type { };
+
+template <typename T>
+struct is_ascending_comparator<std::less_equal<void>, T> : std::true_type { };
+
+
+template <typename Iterator, typename T>
+struct is_contiguous_iterator : std::integral_constant<bool,
+    std::is_same<Iterator, T*>::value ||
+    std::is_same<Iterator, typename std::vector<T>::iterator>::value> { };
+
+
+template <typename T>
+struct is_simd_sortable_type : std::integral_constant<bool,
+    std::is_same<T, int32_t>::value ||
+    std::is_same<T, float>::value> { };
+
+
+// -0.0 and +0.0 are equal but distinguishable, so floats are left to the scalar code in stable sorts
+template <typename T>
+struct is_simd_stable_type : std::is_same<T, int32_t> { };
+
+
+template <typename Comparator, typename T, typename... Iterators>
+struct is_simd_sortable;
+
+template <typename Comparator, typename T>
+struct is_simd_sortable<Comparator, T> : std::integral_constant<bool,
+#ifdef SIMD_SORT_AVX2
+    is_simd_sortable_type<T>::value && is_ascending_comparator<Comparator, T>::value
+#else
+    false
+#endif
+    > { };
+
+template <typename Comparator, typename T, typename Iterator, typename... Iterators>
+struct is_simd_sortable<Comparator, T, Iterator, Iterators...> : std::integral_constant<bool,
+    is_contiguous_iterator<Iterator, T>::value && is_simd_sortable<Comparator, T, Iterators...>::value> { };
+
+
+#ifdef SIMD_SORT_AVX2
+
+#define SIMD_SORT_TARGET __attribute__((target("avx2")))
+
+inline bool cpu_has_avx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+
+// the kernels compare 32-bit signed keys; floats are mapped to integers with the same order
+// (negative numbers get their magnitude bits flipped), which also keeps NaNs from being duplicated by min/max
+template <typename T>
+struct SimdKey;
+
+template <>
+struct SimdKey<int32_t> {
+    static int32_t key(int32_t value)
+    {
+        return value;
+    }
+
+    static SIMD_SORT_TARGET __m256i load(const int32_t* data)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    }
+
+    static SIMD_SORT_TARGET void store(int32_t* data, __m256i keys)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), keys);
+    }
+
+    static void store_one(int32_t* data, int32_t key)
+    {
+        *data = key;
+    }
+};
+
+template <>
+struct SimdKey<float> {
+    static int32_t key(float value)
+    {
+        int32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits ^ ((bits >> 31) & 0x7fffffff);
+    }
+
+    static SIMD_SORT_TARGET __m256i load(const float* data)
+    {
+        __m256i bits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        return _mm256_xor_si256(bits, _mm256_and_si256(_mm256_srai_epi32(bits, 31), _mm256_set1_epi32(0x7fffffff)));
+    }
+
+    static SIMD_SORT_TARGET void store(float* data, __m256i keys)
+    {
+        __m256i bits = _mm256_xor_si256(keys, _mm256_and_si256(_mm256_srai_epi32(keys, 31), _mm256_set1_epi32(0x7fffffff)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), bits);
+    }
+
+    static void store_one(float* data, int32_t key)
+    {
+        int32_t bits = key ^ ((key >> 31) & 0x7fffffff);
+        std::memcpy(data, &bits, sizeof(bits));
+    }
+};
+
+
+// one layer of a sorting network: every lane is compared with lane ^ Distance,
+// lanes set in Mask keep the maximum of the pair
+template <int Distance, int Mask>
+SIMD_SORT_TARGET inline __m256i simd_compare_exchange(__m256i v)
+{
+    const __m256i partner = Distance == 1 ? _mm256_setr_epi32(1, 0, 3, 2, 5, 4, 7, 6) :
+                            Distance == 2 ? _mm256_setr_epi32(2, 3, 0, 1, 6, 7, 4, 5) :
+                                            _mm256_setr_epi32(4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i p = _mm256_permutevar8x32_epi32(v, partner);
+
+    return _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), Mask);
+}
+
+
+// bitonic sorting network for 8 lanes
+SIMD_SORT_TARGET inline __m256i simd_sort8(__m256i v)
+{
+    v = simd_compare_exchange<1, 0x66>(v);
+    v = simd_compare_exchange<2, 0x3C>(v);
+    v = simd_compare_exchange<1, 0x5A>(v);
+    v = simd_compare_exchange<4, 0xF0>(v);
+    v = simd_compare_exchange<2, 0xCC>(v);
+    return simd_compare_exchange<1, 0xAA>(v);
+}
+
+
+// sorts a bitonic sequence of 8 lanes
+SIMD_SORT_TARGET inline __m256i simd_bitonic_clean(__m256i v)
+{
+    v = simd_compare_exchange<4, 0xF0>(v);
+    v = simd_compare_exchange<2, 0xCC>(v);
+    return simd_compare_exchange<1, 0xAA>(v);
+}
+
+
+// merges two sorted vectors, the lower half ends up in low and the upper one in high
+SIMD_SORT_TARGET inline void simd_merge16(__m256i& low, __m256i& high)
+{
+    __m256i reversed = _mm256_permutevar8x32_epi32(high, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+
+    high = simd_bitonic_clean(_mm256_max_epi32(low, reversed));
+    low = simd_bitonic_clean(_mm256_min_epi32(low, reversed));
+}
+
+
+// merges sorted [a, a + size1) and [b, b + size2) into out; out may start at a copy of a
+// placed right before b, like in the in-place merge of the bottom-up sort
+template <typename T>
+SIMD_SORT_TARGET void avx2_merge(const T* a, size_t size1, const T* b, size_t size2, T* out)
+{
+    typedef SimdKey<T> K;
+
+    size_t i = 0, j = 0;
+    int32_t carry[8];
+    size_t carry_size = 0, carry_pos = 0;
+
+    if (size1 >= 8 && size2 >= 8) {
+        __m256i low = K::load(a), high = K::load(b);
+        i = j = 8;
+
+        simd_merge16(low, high);
+        K::store(out, low);
+        out += 8;
+
+        while (true) {
+            bool can_a = i + 8 <= size1, can_b = j + 8 <= size2;
+
+            // the next block comes from the side with the smaller head, a side with a partial block left stops the loop
+            if (can_a && (can_b ? K::key(a[i]) < K::key(b[j]) : j == size2)) {
+                low = K::load(a + i);
+                i += 8;
+            }
+            else if (can_b && (can_a || i == size1)) {
+                low = K::load(b + j);
+                j += 8;
+            }
+            else {
+                break;
+            }
+
+            simd_merge16(low, high);
+            K::store(out, low);
+            out += 8;
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(carry), high);
+        carry_size = 8;
+    }
+
+    // the largest block merged so far and the tails of both inputs
+    while (carry_pos < carry_size || i < size1 || j < size2) {
+        int32_t best = std::numeric_limits<int32_t>::max();
+        int source = -1;
+
+        if (carry_pos < carry_size) {
+            best = carry[carry_pos];
+            source = 0;
+        }
+        if (i < size1 && (source < 0 || K::key(a[i]) < best)) {
+            best = K::key(a[i]);
+            source = 1;
+        }
+        if (j < size2 && (source < 0 || K::key(b[j]) < best)) {
+            best = K::key(b[j]);
+            source = 2;
+        }
+
+        if (source == 0) {
+            K::store_one(out++, carry[carry_pos++]);
+        }
+        else if (source == 1) {
+            *out++ = a[i++];
+        }
+        else {
+            *out++ = b[j++];
+        }
+    }
+}
+
+
+// sorts up to SIMD_SORT_BLOCK elements: pads to whole vectors, sorts every vector with the network
+// and merges the sorted vectors pairwise
+template <typename T>
+SIMD_SORT_TARGET void avx2_sort_block(T* data, size_t size)
+{
+    typedef SimdKey<T> K;
+
+    alignas(32) int32_t keys[2][SIMD_SORT_BLOCK];
+    size_t padded = (size + 7) & ~size_t(7);
+
+    for (size_t i = 0; i < padded; i += 8) {
+        __m256i v;
+        if (i + 8 <= size) {
+            v = K::load(data + i);
+        }
+        else {
+            T tail[8];
+            std::fill(tail, tail + 8, data[i]);
+            std::copy(data + i, data + size, tail);
+            v = K::load(tail);
+
+            // padding lanes get the largest key and are cut off after sorting
+            __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            __m256i padding = _mm256_cmpgt_epi32(lane, _mm256_set1_epi32(static_cast<int32_t>(size - i - 1)));
+            v = _mm256_blendv_epi8(v, _mm256_set1_epi32(std::numeric_limits<int32_t>::max()), padding);
+        }
+        _mm256_store_si256(reinterpret_cast<__m256i*>(keys[0] + i), simd_sort8(v));
+    }
+
+    size_t from = 0;
+
+    for (size_t run = 8; run < padded; run *= 2, from ^= 1) {
+        for (size_t begin = 0; begin < padded; begin += 2 * run) {
+            size_t middle = std::min(begin + run, padded), end = std::min(begin + 2 * run, padded);
+            avx2_merge(keys[from] + begin, middle - begin, keys[from] + middle, end - middle, keys[from ^ 1] + begin);
+        }
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        K::store_one(data + i, keys[from][i]);
+    }
+}
+
+#endif
+
+
+// sorts [begin, end) with the vector kernels if possible, returns false if the caller has to sort it
+template <typename RandomIt, typename Comparator>
+typename std::enable_if<!is_simd_sortable<Comparator, typename std::iterator_traits<RandomIt>::value_type,
+                                          RandomIt>::value, bool>::type
+simd_sort_block(RandomIt, RandomIt, Comparator)
+{
+    return false;
+}
+
+
+// merges two sorted ranges with the vector kernel if possible, returns false if the caller has to merge them
+template <typename InputIt1, typename InputIt2, typename OutIt, typename Comparator>
+typename std::enable_if<!is_simd_sortable<Comparator, typename std::iterator_traits<OutIt>::value_type,
+                                          InputIt1, InputIt2, OutIt>::value, bool>::type
+simd_merge(InputIt1, InputIt1, InputIt2, InputIt2, OutIt, Comparator)
+{
+    return false;
+}
+
+
+#ifdef SIMD_SORT_AVX2
+
+template <typename RandomIt, typename Comparator>
+typename std::enable_if<is_simd_sortable<Comparator, typename std::iterator_traits<RandomIt>::value_type,
+                                         RandomIt>::value, bool>::type
+simd_sort_block(RandomIt begin, RandomIt end, Comparator)
+{
+    size_t size = end - begin;
+
+    if (size > SIMD_SORT_BLOCK || !cpu_has_avx2()) {
+        return false;
+    }
+    if (size > 1) {
+        avx2_sort_block(&*begin, size);
+    }
+
+    return true;
+}
+
+
+template <typename InputIt1, typename InputIt2, typename OutIt, typename Comparator>
+typename std::enable_if<is_simd_sortable<Comparator, typename std::iterator_traits<OutIt>::value_type,
+                                         InputIt1, InputIt2, OutIt>::value, bool>::type
+simd_merge(InputIt1 begin1, InputIt1 end1, InputIt2 begin2, InputIt2 end2, OutIt output, Comparator)
+{
+    size_t size1 = end1 - begin1, size2 = end2 - begin2;
+
+    if (size1 < 8 || size2 < 8 || !cpu_has_avx2()) {
+        return false;
+    }
+
+    avx2_merge(&*begin1, size1, &*begin2, size2, &*output);
+
+    return true;
+}
+
+#endif
+
+
+template <typename RandomIt, typename Comparator>
+bool simd_stable_sort_block(RandomIt begin, RandomIt end, Comparator cmp, std::true_type)
+{
+    return simd_sort_block(begin, end, cmp);
+}
+
+template <typename RandomIt, typename Comparator>
+bool simd_stable_sort_block(RandomIt, RandomIt, Comparator, std::false_type)
+{
+    return false;
+}
+
+// simd_sort_block() for the stable sorts
+template <typename RandomIt, typename Comparator>
+bool simd_stable_sort_block(RandomIt begin, RandomIt end, Comparator cmp)
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+
+    return simd_stable_sort_block(begin, end, cmp, is_simd_stable_type<value_type>());
+}
+
+
+template <typename InputIt1, typename InputIt2, typename OutIt, typename Comparator>
+bool simd_stable_merge(InputIt1 begin1, InputIt1 end1, InputIt2 begin2, InputIt2 end2, OutIt output, Comparator cmp,
+                       std::true_type)
+{
+    return simd_merge(begin1, end1, begin2, end2, output, cmp);
+}
+
+template <typename InputIt1, typename InputIt2, typename OutIt, typename Comparator>
+bool simd_stable_merge(InputIt1, InputIt1, InputIt2, InputIt2, OutIt, Comparator, std::false_type)
+{
+    return false;
+}
+
+// simd_merge() for the stable sorts
+template <typename InputIt1, typename InputIt2, typename OutIt, typename Comparator>
+bool simd_stable_merge(InputIt1 begin1, InputIt1 end1, InputIt2 begin2, InputIt2 end2, OutIt output, Comparator cmp)
+{
+    typedef typename std::iterator_traits<OutIt>::value_type value_type;
+
+    return simd_stable_merge(begin1, end1, begin2, end2, output, cmp, is_simd_stable_type<value_type>());
+}
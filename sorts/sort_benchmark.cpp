@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bottom_up_merge_sort.hpp"
+#include "qsort.hpp"
+#include "parallel_qsort.hpp"
+#include "radix_sort.hpp"
+#include "sample_sort.hpp"
+#include "top_down_merge_sort.hpp"
+
+
+// benchmark of the sort engines: times every engine on every element type, distribution and size
+// and counts comparisons and element moves through wrappers; prints CSV to stdout
+//
+// usage: sort_benchmark [max_size] [threads]
+// sizes go from 10 up to max_size (10^7 by default, 10^9 needs a machine with enough memory) by powers of 10
+
+
+struct Record64 {
+    int64_t key;
+    char payload[56];
+
+    bool operator< (const Record64& that) const
+    {
+        return key < that.key;
+    }
+};
+
+
+struct Counters {
+    std::atomic<size_t> comparisons;
+    std::atomic<size_t> moves;
+
+    void reset()
+    {
+        comparisons = 0;
+        moves = 0;
+    }
+};
+
+Counters counters;
+
+
+// element wrapper that counts copies and moves
+template <typename T>
+struct Counted {
+    T value;
+
+    Counted() :
+        value()
+    { }
+
+    explicit Counted(const T& value) :
+        value(value)
+    { }
+
+    Counted(const Counted& that) :
+        value(that.value)
+    {
+        counters.moves.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Counted(Counted&& that) :
+        value(std::move(that.value))
+    {
+        counters.moves.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Counted& operator= (const Counted& that)
+    {
+        value = that.value;
+        counters.moves.fetch_add(1, std::memory_order_relaxed);
+        return *this;
+    }
+
+    Counted& operator= (Counted&& that)
+    {
+        value = std::move(that.value);
+        counters.moves.fetch_add(1, std::memory_order_relaxed);
+        return *this;
+    }
+
+    bool operator< (const Counted& that) const
+    {
+        return value < that.value;
+    }
+};
+
+
+template <typename T>
+struct CountingLess {
+    bool operator() (const T& a, const T& b) const
+    {
+        counters.comparisons.fetch_add(1, std::memory_order_relaxed);
+        return a < b;
+    }
+};
+
+
+// key used by radix_sort() for the types that have one
+inline int32_t radix_key(int32_t value) { return value; }
+inline int64_t radix_key(int64_t value) { return value; }
+inline double radix_key(double value) { return value; }
+inline int64_t radix_key(const Record64& value) { return value.key; }
+
+template <typename T>
+auto radix_key(const Counted<T>& value) -> decltype(radix_key(value.value))
+{
+    return radix_key(value.value);
+}
+
+template <typename T>
+struct has_radix_key {
+    template <typename U> static auto test(int) -> decltype(radix_key(std::declval<const U&>()), std::true_type());
+    template <typename U> static std::false_type test(...);
+
+    static const bool value = decltype(test<T>(0))::value;
+};
+
+struct RadixKeyOf {
+    template <typename T>
+    auto operator() (const T& value) const -> decltype(radix_key(value))
+    {
+        return radix_key(value);
+    }
+};
+
+
+// element values are built from 64-bit keys so that every type gets the same order
+template <typename T> T make_value(uint64_t key);
+
+template <> int32_t make_value<int32_t>(uint64_t key) { return static_cast<int32_t>(key); }
+template <> int64_t make_value<int64_t>(uint64_t key) { return static_cast<int64_t>(key); }
+template <> double make_value<double>(uint64_t key) { return static_cast<double>(key) * 0.5; }
+
+template <> std::string make_value<std::string>(uint64_t key)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "key%020llu", static_cast<unsigned long long>(key));
+    return buffer;
+}
+
+template <> Record64 make_value<Record64>(uint64_t key)
+{
+    Record64 record;
+    record.key = static_cast<int64_t>(key);
+    std::memset(record.payload, static_cast<int>(key & 0xff), sizeof(record.payload));
+    return record;
+}
+
+
+const char* DISTRIBUTIONS[] = {"random", "sorted", "reversed", "organ_pipe", "few_unique", "sawtooth"};
+
+
+std::vector<uint64_t> make_keys(const std::string& distribution, size_t size)
+{
+    std::vector<uint64_t> keys(size);
+    std::mt19937_64 random(size);
+
+    for (size_t i = 0; i < size; i++) {
+        if (distribution == "random") {
+            keys[i] = random() >> 33;
+        }
+        else if (distribution == "sorted") {
+            keys[i] = i;
+        }
+        else if (distribution == "reversed") {
+            keys[i] = size - i;
+        }
+        else if (distribution == "organ_pipe") {
+            keys[i] = i < size / 2 ? i : size - i;
+        }
+        else if (distribution == "few_unique") {
+            keys[i] = random() % 16;
+        }
+        else {
+            keys[i] = i % 1000;
+        }
+    }
+
+    return keys;
+}
+
+
+template <typename T>
+struct Engine {
+    std::string name;
+    std::function<void(std::vector<T>&)> sort;
+};
+
+
+template <typename T>
+void add_radix_engine(std::vector<Engine<T>>& engines, std::true_type)
+{
+    engines.push_back({"radix_sort", [](std::vector<T>& v) { radix_sort(v.begin(), v.end(), RadixKeyOf()); }});
+}
+
+template <typename T>
+void add_radix_engine(std::vector<Engine<T>>&, std::false_type)
+{ }
+
+
+template <typename T, typename Comparator>
+std::vector<Engine<T>> make_engines(Comparator cmp, size_t threads)
+{
+    std::vector<Engine<T>> engines = {
+        {"qsort",               [=](std::vector<T>& v) { qsort(v.begin(), v.end(), cmp); }},
+        {"introsort",           [=](std::vector<T>& v) { introsort(v.begin(), v.end(), cmp); }},
+        {"top_down_merge_sort", [=](std::vector<T>& v) { merge_sort(v.begin(), v.end(), cmp); }},
+        {"bottom_up_merge_sort",[=](std::vector<T>& v) { bottom_up_merge_sort(v.begin(), v.end(), cmp); }},
+        {"tim_sort",            [=](std::vector<T>& v) { tim_sort(v.begin(), v.end(), cmp); }},
+        {"parallel_qsort",      [=](std::vector<T>& v) { parallel_qsort(v.begin(), v.end(), cmp, threads); }},
+        {"parallel_merge_sort", [=](std::vector<T>& v) { parallel_merge_sort(v.begin(), v.end(), cmp, threads); }},
+        {"sample_sort",         [=](std::vector<T>& v) { sample_sort(v.begin(), v.end(), cmp, threads); }},
+        {"std::sort",           [=](std::vector<T>& v) { std::sort(v.begin(), v.end(), cmp); }},
+        {"std::stable_sort",    [=](std::vector<T>& v) { std::stable_sort(v.begin(), v.end(), cmp); }},
+    };
+
+    add_radix_engine(engines, std::integral_constant<bool, has_radix_key<T>::value>());
+
+    return engines;
+}
+
+
+// the counting run is repeated on wrapped elements only up to this size, it is much slower
+const size_t COUNTING_MAX_SIZE = 1000000;
+// small sizes are repeated until about this many elements have been sorted
+const size_t ELEMENTS_PER_MEASUREMENT = 1000000;
+
+
+template <typename T>
+void benchmark_type(const std::string& type, size_t max_size, size_t threads)
+{
+    auto engines = make_engines<T>(std::less<T>(), threads);
+    auto counting_engines = make_engines<Counted<T>>(CountingLess<Counted<T>>(), threads);
+
+    for (size_t size = 10; size <= max_size; size *= 10) {
+        for (const char* distribution: DISTRIBUTIONS) {
+            std::vector<uint64_t> keys = make_keys(distribution, size);
+
+            std::vector<T> input(size);
+            for (size_t i = 0; i < size; i++) {
+                input[i] = make_value<T>(keys[i]);
+            }
+
+            for (size_t e = 0; e < engines.size(); e++) {
+                size_t repeats = std::max<size_t>(1, ELEMENTS_PER_MEASUREMENT / size);
+                double seconds = 0;
+                bool sorted = true;
+
+                for (size_t r = 0; r < repeats; r++) {
+                    std::vector<T> data = input;
+
+                    auto start = std::chrono::steady_clock::now();
+                    engines[e].sort(data);
+                    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                    sorted = sorted && std::is_sorted(data.begin(), data.end());
+                }
+
+                if (!sorted) {
+                    std::cerr << "error: " << engines[e].name << " did not sort "
+                              << type << " " << distribution << " " << size << std::endl;
+                }
+
+                long long comparisons = -1, moves = -1;
+
+                if (size <= COUNTING_MAX_SIZE) {
+                    std::vector<Counted<T>> data;
+                    data.reserve(size);
+                    for (auto& value: input) {
+                        data.emplace_back(value);
+                    }
+
+                    counters.reset();
+                    counting_engines[e].sort(data);
+                    comparisons = counters.comparisons;
+                    moves = counters.moves;
+                }
+
+                std::cout << engines[e].name << ","
+                          << type << ","
+                          << distribution << ","
+                          << size << ","
+                          << seconds * 1e9 / (static_cast<double>(size) * repeats) << ","
+                          << comparisons << ","
+                          << moves << std::endl;
+            }
+        }
+    }
+}
+
+
+// the stable engines have to keep -0.0 and +0.0, which compare equal, in their input order;
+// the merge sorts are stable with a non-strict comparator, tim_sort with both kinds
+void check_float_stability(size_t threads)
+{
+    typedef std::function<void(std::vector<float>&)> Sort;
+
+    std::vector<std::pair<std::string, Sort>> engines = {
+        {"top_down_merge_sort", [](std::vector<float>& v) { merge_sort(v.begin(), v.end(), std::less_equal<float>()); }},
+        {"bottom_up_merge_sort",[](std::vector<float>& v) { bottom_up_merge_sort(v.begin(), v.end(), std::less_equal<float>()); }},
+        {"tim_sort",            [](std::vector<float>& v) { tim_sort(v.begin(), v.end(), std::less<float>()); }},
+        {"parallel_merge_sort", [=](std::vector<float>& v) {
+            parallel_merge_sort(v.begin(), v.end(), std::less_equal<float>(), threads, 1 << 10);
+        }},
+    };
+
+    std::mt19937_64 random(0);
+    std::vector<float> input(100000);
+    for (auto& value: input) {
+        value = static_cast<float>(static_cast<int>(random() % 5) - 2);
+        if (value == 0 && random() % 2) {
+            value = -0.0f;
+        }
+    }
+
+    std::vector<bool> signs;
+    for (float value: input) {
+        if (value == 0) {
+            signs.push_back(std::signbit(value));
+        }
+    }
+
+    for (auto& engine: engines) {
+        std::vector<float> data = input;
+        engine.second(data);
+
+        std::vector<bool> sorted_signs;
+        for (float value: data) {
+            if (value == 0) {
+                sorted_signs.push_back(std::signbit(value));
+            }
+        }
+
+        if (!std::is_sorted(data.begin(), data.end()) || sorted_signs != signs) {
+            std::cerr << "error: " << engine.first << " is not stable on float" << std::endl;
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    size_t max_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+
+    check_float_stability(threads);
+
+    std::cout << "engine,type,distribution,size,ns_per_element,comparisons,moves" << std::endl;
+
+    benchmark_type<int32_t>("int32", max_size, threads);
+    benchmark_type<int64_t>("int64", max_size, threads);
+    benchmark_type<double>("double", max_size, threads);
+    benchmark_type<std::string>("string", max_size, threads);
+    benchmark_type<Record64>("record64", max_size, threads);
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// work-stealing thread pool: every worker owns a task deque, pops its own tasks from the back
+// and steals from the front of the others when it runs dry
+class ThreadPool {
+public:
+    typedef std::function<void()> task_type;
+
+    explicit ThreadPool(size_t threads) :
+        _queued(0),
+        _next(0),
+        _stop(false)
+    {
+        for (size_t i = 0; i < threads; i++) {
+            _queues.emplace_back(new Queue());
+        }
+        for (size_t i = 0; i < threads; i++) {
+            _threads.emplace_back(&ThreadPool::_worker, this, i);
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator= (const ThreadPool&) = delete;
+
+   ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+
+        for (auto& thread: _threads) {
+            thread.join();
+        }
+    }
+
+    size_t size() const
+    {
+        return _threads.size();
+    }
+
+    void submit(task_type task)
+    {
+        if (_queues.empty()) {
+            task();
+            return;
+        }
+
+        size_t index = _current().first == this ? _current().second : _next++ % _queues.size();
+        // counted with the push, under the same lock as the pop or steal that uncounts it, so it cannot wrap below 0
+        {
+            std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+            _queues[index]->tasks.push_back(std::move(task));
+            _queued++;
+        }
+        // a worker checks _queued under _mutex before it sleeps, taking it here keeps the wakeup from being lost
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+        }
+        _cv.notify_one();
+    }
+
+    // runs one queued task on the calling thread, returns false if there was nothing to run
+    bool run_pending()
+    {
+        task_type task;
+        size_t index = _current().first == this ? _current().second : 0;
+
+        if (!_pop(index, task) && !_steal(index, task)) {
+            return false;
+        }
+
+        task();
+        return true;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _queued;
+    std::atomic<size_t> _next;
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    static std::pair<const ThreadPool*, size_t>& _current()
+    {
+        static thread_local std::pair<const ThreadPool*, size_t> current(nullptr, 0);
+        return current;
+    }
+
+    bool _pop(size_t index, task_type& task)
+    {
+        if (index >= _queues.size()) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        if (_queues[index]->tasks.empty()) {
+            return false;
+        }
+
+        task = std::move(_queues[index]->tasks.back());
+        _queues[index]->tasks.pop_back();
+        _queued--;
+
+        return true;
+    }
+
+    bool _steal(size_t index, task_type& task)
+    {
+        for (size_t i = 1; i <= _queues.size(); i++) {
+            Queue& victim = *_queues[(index + i) % _queues.size()];
+
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                _queued--;
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void _worker(size_t index)
+    {
+        _current() = std::make_pair(this, index);
+
+        while (true) {
+            if (run_pending()) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this] { return _stop || _queued > 0; });
+
+            if (_stop) {
+                return;
+            }
+        }
+    }
+};
+
+
+// set of tasks submitted to a pool that can be waited for; the waiting thread runs queued tasks
+// instead of blocking, so tasks may fork and wait for subtasks themselves
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) :
+        _pool(pool),
+        _pending(0)
+    { }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator= (const TaskGroup&) = delete;
+
+   ~TaskGroup()
+    {
+        while (_pending > 0) {
+            if (!_pool.run_pending()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    template <typename Function>
+    void run(Function function)
+    {
+        _pending++;
+        _pool.submit([this, function]() {
+            try {
+                function();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (!_error) {
+                    _error = std::current_exception();
+                }
+            }
+            _pending--;
+        });
+    }
+
+    void wait()
+    {
+        while (_pending > 0) {
+            if (!_pool.run_pending()) {
+                std::this_thread::yield();
+            }
+        }
+
+        if (_error) {
+            std::exception_ptr error = _error;
+            _error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    ThreadPool& _pool;
+    std::atomic<size_t> _pending;
+    std::mutex _mutex;
+    std::exception_ptr _error;
+};
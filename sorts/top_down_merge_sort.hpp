@@ -1,4 +1,15 @@
+#pragma once
+
 #include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "simd_sort.hpp"
+#include "thread_pool.hpp"
+
+
+const size_t MERGE_SORT_INSERTION_THRESHOLD = 16;
+const size_t PARALLEL_MERGE_SORT_GRAIN = 1 << 14;
 
 
 template <typename RandomIt, typename OutIt, typename Comparator>
@@ -6,45 +17,192 @@ void merge(RandomIt begin1, RandomIt end1,
            RandomIt begin2, RandomIt end2, 
            OutIt output, Comparator comp)
 {
+    if (simd_stable_merge(begin1, end1, begin2, end2, output, comp)) {
+        return;
+    }
+
     while (begin1 != end1 && begin2 != end2) {
         if (comp(*begin1, *begin2)) {
-            *output = *begin1;
+            *output = std::move(*begin1);
             output++;
             begin1++;
         }
         else {
-            *output = *begin2;
+            *output = std::move(*begin2);
             output++;
             begin2++;
         }
     }
 
-    while (begin1 != end1) {
-        *output++ = *begin1++;
+    output = std::move(begin1, end1, output);
+    std::move(begin2, end2, output);
+}
+
+// insertion sort for short runs, breaks ties the same way merge() does
+template <typename RandomIt, typename Comparator>
+void run_insertion_sort(RandomIt begin, RandomIt end, Comparator comp)
+{
+    if (begin == end) {
+        return;
+    }
+
+    for (RandomIt i = begin + 1; i != end; ++i) {
+        auto value = std::move(*i);
+        RandomIt j = i;
+
+        for (; j != begin && !comp(*(j - 1), value); --j) {
+            *j = std::move(*(j - 1));
+        }
+
+        *j = std::move(value);
+    }
+}
+
+
+// sorts [begin, end) leaving the result in place, or in [buffer, buffer + size) if to_buffer is set.
+// Levels alternate between the range and the buffer, so merged runs are never copied back
+template <typename RandomIt, typename BufferIt, typename Comparator>
+void merge_sort(RandomIt begin, RandomIt end, BufferIt buffer, bool to_buffer, Comparator comp)
+{
+    size_t size = end - begin;
+
+    if (size <= SIMD_SORT_BLOCK && simd_stable_sort_block(begin, end, comp)) {
+        if (to_buffer) {
+            std::move(begin, end, buffer);
+        }
+        return;
+    }
+
+    if (size <= MERGE_SORT_INSERTION_THRESHOLD) {
+        run_insertion_sort(begin, end, comp);
+        if (to_buffer) {
+            std::move(begin, end, buffer);
+        }
+        return;
     }
 
-    while (begin2 != end2) {
-        *output++ = *begin2++;
+    RandomIt pivot = begin + size / 2;
+
+    merge_sort(begin, pivot, buffer, !to_buffer, comp);
+    merge_sort(pivot, end, buffer + size / 2, !to_buffer, comp);
+
+    if (to_buffer) {
+        merge(begin, pivot, pivot, end, buffer, comp);
+    }
+    else {
+        merge(buffer, buffer + size / 2, buffer + size / 2, buffer + size, begin, comp);
     }
 }
 
 template <typename RandomIt, typename Comparator>
 void merge_sort(RandomIt begin, RandomIt end, Comparator comp)
 {
-    typedef typename RandomIt::value_type value_type;
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
 
     size_t size = end - begin;
-    RandomIt pivot = begin + size / 2;    
 
     if (size > 1) {
-        value_type* tmp = new value_type[size];
+        std::vector<value_type> buffer(size);
+        merge_sort(begin, end, buffer.begin(), false, comp);
+    }
+}
+
+
+// number of elements merge() takes from the first sequence before writing output position `diagonal`;
+// found by binary search over the merge path, it reproduces the choices of merge() exactly, ties included
+template <typename RandomIt, typename Comparator>
+size_t co_rank(size_t diagonal, RandomIt begin1, size_t size1, RandomIt begin2, size_t size2, Comparator comp)
+{
+    size_t low = diagonal > size2 ? diagonal - size2 : 0;
+    size_t high = std::min(diagonal, size1);
+
+    while (low < high) {
+        size_t i = low + (high - low) / 2;
+
+        if (comp(*(begin1 + i), *(begin2 + (diagonal - i - 1)))) {
+            low = i + 1;
+        }
+        else {
+            high = i;
+        }
+    }
+
+    return low;
+}
+
+
+// splits the output into chunks of about `grain` elements and merges them independently
+template <typename RandomIt, typename OutIt, typename Comparator>
+void parallel_merge(RandomIt begin1, RandomIt end1,
+                    RandomIt begin2, RandomIt end2,
+                    OutIt output, Comparator comp, size_t grain, ThreadPool& pool)
+{
+    size_t size1 = end1 - begin1, size2 = end2 - begin2;
+    size_t size = size1 + size2;
+    size_t chunks = (size + grain - 1) / grain;
+
+    TaskGroup group(pool);
+
+    for (size_t k = 0; k < chunks; k++) {
+        size_t diagonal_begin = size * k / chunks, diagonal_end = size * (k + 1) / chunks;
+        size_t i_begin = co_rank(diagonal_begin, begin1, size1, begin2, size2, comp);
+        size_t i_end = co_rank(diagonal_end, begin1, size1, begin2, size2, comp);
+        size_t j_begin = diagonal_begin - i_begin, j_end = diagonal_end - i_end;
+
+        group.run([=]() {
+            merge(begin1 + i_begin, begin1 + i_end, begin2 + j_begin, begin2 + j_end, output + diagonal_begin, comp);
+        });
+    }
+
+    group.wait();
+}
+
+
+template <typename RandomIt, typename BufferIt, typename Comparator>
+void parallel_merge_sort(RandomIt begin, RandomIt end, BufferIt buffer, bool to_buffer,
+                         Comparator comp, size_t grain, ThreadPool& pool)
+{
+    size_t size = end - begin;
+
+    if (size <= grain) {
+        merge_sort(begin, end, buffer, to_buffer, comp);
+        return;
+    }
+
+    RandomIt pivot = begin + size / 2;
+
+    {
+        TaskGroup group(pool);
+        group.run([=, &pool]() { parallel_merge_sort(begin, pivot, buffer, !to_buffer, comp, grain, pool); });
+        parallel_merge_sort(pivot, end, buffer + size / 2, !to_buffer, comp, grain, pool);
+        group.wait();
+    }
+
+    if (to_buffer) {
+        parallel_merge(begin, pivot, pivot, end, buffer, comp, grain, pool);
+    }
+    else {
+        parallel_merge(buffer, buffer + size / 2, buffer + size / 2, buffer + size, begin, comp, grain, pool);
+    }
+}
 
-        merge_sort(begin, pivot, comp);
-        merge_sort(pivot, end, comp);
-        merge(begin, pivot, pivot, end, tmp, comp);
 
-        std::copy(tmp, tmp + size, begin);
+// stable in the same way as merge_sort(): equal elements keep their order when comp is non-strict (std::less_equal)
+template <typename RandomIt, typename Comparator>
+void parallel_merge_sort(RandomIt begin, RandomIt end, Comparator comp,
+                         size_t threads, size_t grain = PARALLEL_MERGE_SORT_GRAIN)
+{
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
 
-        delete[] tmp;
+    size_t size = end - begin;
+
+    if (threads <= 1 || size <= grain) {
+        merge_sort(begin, end, comp);
+        return;
     }
+
+    std::vector<value_type> buffer(size);
+    ThreadPool pool(threads - 1);
+
+    parallel_merge_sort(begin, end, buffer.begin(), false, comp, grain, pool);
 }
\ No newline at end of file
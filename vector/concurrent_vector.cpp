@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_vector.h"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+void test_single()
+{
+    ConcurrentVector<std::string> v;
+
+    check(v.empty() && v.size() == 0, "a new vector is empty");
+    check(v.push_back("a") == 0 && v.emplace_back(3, 'b') == 1, "push_back returns the index");
+    check(v.grow_by(100) == 2 && v.size() == 102 && v[101].empty(), "grow_by of default elements");
+    check(v.grow_by(1000, "c") == 102 && v.size() == 1102 && v[1101] == "c", "grow_by of copies across segments");
+    check(v[0] == "a" && v[1] == "bbb", "elements keep their values");
+
+    bool thrown = false;
+    try {
+        v.at(1102);
+    }
+    catch(const std::out_of_range&) {
+        thrown = true;
+    }
+    check(thrown, "at() beyond size()");
+
+    // addresses stay valid while the vector grows
+    const std::string* first = &v[0];
+    v.grow_by(100000);
+    check(&v[0] == first && *first == "a", "elements never move");
+}
+
+
+// values are never 0, so a reader that sees 0 below size() has read an element before it was constructed
+size_t value(size_t thread, size_t i)
+{
+    return (thread << 32) + i + 1;
+}
+
+
+// the elements thread t appends; odd threads append batches of copies of one value with one reservation each
+std::vector<size_t> appended(size_t t, size_t count)
+{
+    std::vector<size_t> values;
+
+    for (size_t i = 0; i < count; ) {
+        size_t n = t % 2 == 0 ? 1 : std::min<size_t>(i % 7 + 1, count - i);
+        values.insert(values.end(), n, value(t, i));
+        i += n;
+    }
+
+    return values;
+}
+
+
+void test_threads(size_t producers, size_t count)
+{
+    ConcurrentVector<size_t> v;
+    std::atomic<size_t> done(0);
+    std::atomic<bool> unconstructed(false), shrunk(false);
+
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < producers; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<size_t> values = appended(t, count);
+
+            for (size_t i = 0; i < values.size(); ) {
+                size_t n = std::find_if(values.begin() + i, values.end(),
+                                        [&](size_t x) { return x != values[i]; }) - values.begin() - i;
+                if (n == 1) {
+                    v.push_back(values[i]);
+                }
+                else {
+                    v.grow_by(n, values[i]);
+                }
+                i += n;
+            }
+            done++;
+        });
+    }
+
+    // a reader scans what is published while the producers run
+    std::thread reader([&]() {
+        size_t last = 0, checked = 0;
+
+        while (done.load() < producers || checked < v.size()) {
+            size_t size = v.size();
+            shrunk = shrunk || size < last;
+            last = size;
+
+            for (; checked < size; checked++) {
+                unconstructed = unconstructed || v.at(checked) == 0;
+            }
+        }
+    });
+
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    reader.join();
+
+    check(!shrunk, "size() never decreases");
+    check(!unconstructed, "every published element is constructed");
+    check(v.size() == producers * count, "every element is published");
+
+    // each thread's elements appear once, in its own order
+    std::vector<std::vector<size_t>> seen(producers);
+    bool known = true;
+    for (size_t i = 0; i < v.size(); i++) {
+        size_t t = v[i] >> 32;
+        known = known && t < producers;
+        if (t < producers) {
+            seen[t].push_back(v[i]);
+        }
+    }
+
+    bool ordered = known;
+    for (size_t t = 0; t < producers; t++) {
+        ordered = ordered && seen[t] == appended(t, count);
+    }
+    check(ordered, "every element appears once, in the order of its thread");
+}
+
+
+void test_concurrent_reads(size_t producers, size_t count)
+{
+    ConcurrentVector<std::string> v;
+    std::atomic<size_t> done(0);
+    std::atomic<bool> unpublished(false);
+
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < producers; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < count; i++) {
+                if (i % 3 == 0) {
+                    v.grow_by(2, std::to_string(t));
+                    i++;
+                }
+                else {
+                    v.push_back(std::to_string(t));
+                }
+            }
+            done++;
+        });
+    }
+
+    // elements below size() are read while other threads construct the ones above it
+    std::thread reader([&]() {
+        while (done.load() < producers) {
+            size_t size = v.size();
+            for (size_t i = 0; i < size; i++) {
+                unpublished = unpublished || v[i].empty();
+            }
+        }
+    });
+
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    reader.join();
+
+    check(!unpublished, "readers see constructed elements only");
+}
+
+
+int main()
+{
+    size_t producers = std::max<size_t>(4, std::thread::hardware_concurrency());
+
+    test_single();
+    test_threads(producers, 100000);
+    test_concurrent_reads(producers, 2000);
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+
+// append-only vector for many concurrent producers: slots are reserved with one fetch_add and stored in
+// segments that double in size, so elements never move and their addresses stay valid for the vector's lifetime.
+// size() only grows over elements that are fully constructed, every element below it can be read by any thread;
+// an element whose construction throws stays unpublished and so do all the elements after it
+
+const size_t CONCURRENT_VECTOR_FIRST_SEGMENT_LOG = 5;
+
+
+template <typename T, typename Allocator = std::allocator<T>>
+class ConcurrentVector {
+public:
+    typedef T                   value_type;
+    typedef Allocator           allocator_type;
+    typedef value_type&         reference;
+    typedef const value_type&   const_reference;
+
+    explicit ConcurrentVector(const allocator_type& allocator = allocator_type()) :
+        _reserved(0),
+        _size(0),
+        _allocator(allocator)
+    {
+        for (auto& segment: _segments) {
+            segment.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ConcurrentVector(const ConcurrentVector&) = delete;
+    ConcurrentVector& operator= (const ConcurrentVector&) = delete;
+
+    // no other thread may use the vector anymore
+   ~ConcurrentVector()
+    {
+        for (size_t k = 0; k < SEGMENTS; k++) {
+            Segment* segment = _segments[k].load(std::memory_order_relaxed);
+            if (segment == nullptr) {
+                continue;
+            }
+
+            for (size_t i = 0; i < _segment_size(k); i++) {
+                if (segment->ready[i].load(std::memory_order_relaxed)) {
+                    _traits::destroy(_allocator, segment->elements + i);
+                }
+            }
+
+            _free_segment(segment, k);
+        }
+    }
+
+    // number of published elements, all of [0, size()) are constructed
+    size_t size() const
+    {
+        return _size.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // returns the index of the new element
+    size_t push_back(const value_type& value)
+    {
+        return emplace_back(value);
+    }
+
+    size_t push_back(value_type&& value)
+    {
+        return emplace_back(std::move(value));
+    }
+
+    template <typename... Args>
+    size_t emplace_back(Args&&... args)
+    {
+        size_t index = _reserved.fetch_add(1, std::memory_order_relaxed);
+
+        _construct(index, std::forward<Args>(args)...);
+        _publish();
+
+        return index;
+    }
+
+    // appends n default constructed elements with one reservation and returns the index of the first one
+    size_t grow_by(size_t n)
+    {
+        return _grow_by(n);
+    }
+
+    size_t grow_by(size_t n, const value_type& value)
+    {
+        return _grow_by(n, value);
+    }
+
+    // the element must be published or have been appended by the calling thread
+    reference operator[] (size_t pos)
+    {
+        size_t offset;
+        size_t k = _locate(pos, offset);
+
+        return _segments[k].load(std::memory_order_acquire)->elements[offset];
+    }
+
+    const_reference operator[] (size_t pos) const
+    {
+        size_t offset;
+        size_t k = _locate(pos, offset);
+
+        return _segments[k].load(std::memory_order_acquire)->elements[offset];
+    }
+
+    reference at(size_t pos)
+    {
+        _range_check(pos);
+        return (*this)[pos];
+    }
+
+    const_reference at(size_t pos) const
+    {
+        _range_check(pos);
+        return (*this)[pos];
+    }
+
+private:
+    static const size_t SEGMENTS = 64 - CONCURRENT_VECTOR_FIRST_SEGMENT_LOG;
+
+    typedef std::allocator_traits<allocator_type> _traits;
+
+    struct Segment {
+        value_type* elements;
+        std::unique_ptr<std::atomic<bool>[]> ready;
+    };
+
+    std::atomic<size_t> _reserved;
+    std::atomic<size_t> _size;
+    std::atomic<Segment*> _segments[SEGMENTS];
+    allocator_type _allocator;
+
+    void _range_check(size_t n) const
+    {
+        if (n >= size()) {
+            throw std::out_of_range("ConcurrentVector::at");
+        }
+    }
+
+    static size_t _segment_size(size_t k)
+    {
+        return size_t(1) << (k + CONCURRENT_VECTOR_FIRST_SEGMENT_LOG);
+    }
+
+    // segment k holds the indices [first << k, first << (k + 1)) shifted down by first, the size of segment 0
+    static size_t _locate(size_t pos, size_t& offset)
+    {
+        size_t shifted = pos + _segment_size(0);
+        size_t log = 63 - __builtin_clzll(shifted);
+
+        offset = shifted - (size_t(1) << log);
+        return log - CONCURRENT_VECTOR_FIRST_SEGMENT_LOG;
+    }
+
+    // the first thread that needs a segment allocates it, the losers of the race free their copy
+    Segment* _segment(size_t k)
+    {
+        Segment* segment = _segments[k].load(std::memory_order_acquire);
+        if (segment != nullptr) {
+            return segment;
+        }
+
+        Segment* allocated = new Segment{nullptr, nullptr};
+        try {
+            allocated->elements = _traits::allocate(_allocator, _segment_size(k));
+            allocated->ready.reset(new std::atomic<bool>[_segment_size(k)]());
+        }
+        catch(...) {
+            _free_segment(allocated, k);
+            throw;
+        }
+
+        if (_segments[k].compare_exchange_strong(segment, allocated, std::memory_order_acq_rel)) {
+            return allocated;
+        }
+
+        _free_segment(allocated, k);
+        return segment;
+    }
+
+    void _free_segment(Segment* segment, size_t k)
+    {
+        if (segment->elements != nullptr) {
+            _traits::deallocate(_allocator, segment->elements, _segment_size(k));
+        }
+
+        delete segment;
+    }
+
+    template <typename... Args>
+    void _construct(size_t index, Args&&... args)
+    {
+        size_t offset;
+        Segment* segment = _segment(_locate(index, offset));
+
+        _traits::construct(_allocator, segment->elements + offset, std::forward<Args>(args)...);
+        segment->ready[offset].store(true);
+    }
+
+    bool _ready(size_t index) const
+    {
+        size_t offset;
+        Segment* segment = _segments[_locate(index, offset)].load(std::memory_order_acquire);
+
+        return segment != nullptr && segment->ready[offset].load();
+    }
+
+    // advances size() over the constructed elements; every producer runs this after marking its element ready,
+    // so the last one of a gap always closes it and no producer ever waits for another. The whole run of ready
+    // elements is published with one CAS, a failed CAS means another producer moved size() and the scan restarts there
+    void _publish()
+    {
+        size_t size = _size.load();
+
+        for (;;) {
+            size_t reserved = _reserved.load();
+            size_t end = size;
+
+            while (end < reserved && _ready(end)) {
+                end++;
+            }
+
+            if (end == size || _size.compare_exchange_weak(size, end)) {
+                return;
+            }
+        }
+    }
+
+    template <typename... Args>
+    size_t _grow_by(size_t n, const Args&... value)
+    {
+        size_t first = _reserved.fetch_add(n, std::memory_order_relaxed);
+
+        for (size_t i = first; i < first + n; i++) {
+            _construct(i, value...);
+        }
+        _publish();
+
+        return first;
+    }
+};
@@ -0,0 +1,182 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_vector.h"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+template <typename T>
+bool opens(const std::string& path)
+{
+    try {
+        FileVector<T> v(path);
+        return true;
+    }
+    catch(const std::runtime_error&) {
+        return false;
+    }
+}
+
+
+size_t file_size(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+}
+
+
+FileVectorHeader read_header(const std::string& path)
+{
+    FileVectorHeader header;
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(&header), sizeof(header));
+    return header;
+}
+
+
+void write_header(const std::string& path, const FileVectorHeader& header)
+{
+    std::fstream(path, std::ios::binary | std::ios::in | std::ios::out)
+        .write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+
+void test_reopen(const std::string& path)
+{
+    {
+        FileVector<int32_t> v(path);
+        check(v.empty(), "a new file holds an empty vector");
+
+        for (int32_t i = 0; i < 100000; i++) {
+            v.push_back(i * 3);
+        }
+    }
+
+    {
+        FileVector<int32_t> v(path);
+        check(v.size() == 100000, "the size is kept across a reopen");
+
+        bool same = true;
+        for (int32_t i = 0; i < 100000; i++) {
+            same = same && v[i] == i * 3;
+        }
+        check(same, "the elements are kept across a reopen");
+
+        v.resize(10);
+        v.push_back(-1);
+    }
+
+    FileVector<int32_t> v(path);
+    check(v.size() == 11 && v[9] == 27 && v[10] == -1, "a shrunk vector is kept across a reopen");
+}
+
+
+void test_sync(const std::string& path)
+{
+    FileVector<int64_t> v(path);
+    for (int64_t i = 0; i < 1000; i++) {
+        v.push_back(i);
+    }
+    v.sync();
+
+    // another reader of the file sees the synced state while the vector is still open
+    FileVectorHeader header = read_header(path);
+    check(header.size == 1000, "sync() writes the size to the header");
+
+    int64_t last = 0;
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(header.data_offset + 999 * sizeof(int64_t));
+    file.read(reinterpret_cast<char*>(&last), sizeof(last));
+    check(last == 999, "sync() writes the elements to the file");
+}
+
+
+void test_rejected(const std::string& path)
+{
+    {
+        FileVector<int32_t> v(path);
+        v.push_back(1);
+    }
+
+    check(!opens<int64_t>(path), "a file of other element size is rejected");
+    check(opens<int32_t>(path), "a file of the right element size is accepted");
+
+    FileVectorHeader header = read_header(path);
+
+    FileVectorHeader wrong = header;
+    wrong.version = FILE_VECTOR_VERSION + 1;
+    write_header(path, wrong);
+    check(!opens<int32_t>(path), "a file of other version is rejected");
+
+    wrong = header;
+    wrong.magic[0] = 'X';
+    write_header(path, wrong);
+    check(!opens<int32_t>(path), "a file without the magic is rejected");
+
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "just some text";
+    check(!opens<int32_t>(path), "a file of other format is rejected");
+}
+
+
+void test_clear(const std::string& path)
+{
+    size_t empty_size;
+    {
+        FileVector<int32_t> v(path);
+        empty_size = file_size(path);
+
+        for (int32_t i = 0; i < 100000; i++) {
+            v.push_back(i);
+        }
+        check(file_size(path) > empty_size, "the file grows with the vector");
+
+        v.clear();
+        check(file_size(path) == empty_size, "clear() truncates the file");
+
+        v.push_back(7);
+        v.pop_back();
+        v.shrink_to_fit();
+        check(file_size(path) == empty_size, "shrink_to_fit() down to 0 truncates the file");
+    }
+
+    FileVector<int32_t> v(path);
+    check(v.empty() && v.capacity() == 0, "a cleared vector reopens empty");
+}
+
+
+int main()
+{
+    std::string path = "/tmp/file_vector_test_" + std::to_string(getpid());
+
+    test_reopen(path);
+    std::remove(path.c_str());
+
+    test_sync(path);
+    std::remove(path.c_str());
+
+    test_rejected(path);
+    std::remove(path.c_str());
+
+    test_clear(path);
+    std::remove(path.c_str());
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vector.h"
+
+
+// vector of trivially copyable elements stored in a file: opening an existing file maps it without reading
+// or parsing anything, growing extends the file and the mapping, sync() makes the contents durable
+
+const char FILE_VECTOR_MAGIC[8] = "FVECTOR";
+const uint32_t FILE_VECTOR_VERSION = 1;
+
+
+struct FileVectorHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t element_size;
+    uint64_t size;
+    // the elements start at a page boundary so that they can be mapped
+    uint64_t data_offset;
+};
+
+
+// the file behind a FileVector: a header page followed by the elements
+class MappedFile {
+public:
+    MappedFile(const std::string& path, size_t element_size) :
+        _fd(open(path.c_str(), O_RDWR | O_CREAT, 0644)),
+        _closing(false)
+    {
+        if (_fd < 0) {
+            _throw_errno("open " + path);
+        }
+
+        try {
+            _open(path, element_size);
+        }
+        catch(...) {
+            close(_fd);
+            throw;
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator= (const MappedFile&) = delete;
+
+   ~MappedFile()
+    {
+        close(_fd);
+    }
+
+    size_t size() const
+    {
+        return _header.size;
+    }
+
+    size_t data_bytes() const
+    {
+        return _file_size - _header.data_offset;
+    }
+
+    void* map(size_t bytes)
+    {
+        _resize(bytes);
+
+        void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, _header.data_offset);
+        if (ptr == MAP_FAILED) {
+            _throw_errno("mmap");
+        }
+
+        return ptr;
+    }
+
+    // the file is extended before a mapping grows and truncated after it shrinks, never under a live page
+    void* remap(void* ptr, size_t old_bytes, size_t bytes)
+    {
+        if (bytes > old_bytes) {
+            _resize(bytes);
+        }
+
+        void* moved = mremap(ptr, old_bytes, bytes, MREMAP_MAYMOVE);
+        if (moved == MAP_FAILED) {
+            _throw_errno("mremap");
+        }
+
+        if (bytes < old_bytes) {
+            _resize(bytes);
+        }
+
+        return moved;
+    }
+
+    // the data goes with its mapping, the file is truncated as well unless the vector is being closed;
+    // deallocation cannot fail, so a file that could not be truncated keeps its length
+    void unmap(void* ptr, size_t bytes)
+    {
+        munmap(ptr, bytes);
+
+        if (!_closing && ftruncate(_fd, _header.data_offset) == 0) {
+            _file_size = _header.data_offset;
+        }
+    }
+
+    // the mapping released from now on is the one of a vector being closed, its data stays in the file
+    void close_data()
+    {
+        _closing = true;
+    }
+
+    void write_size(size_t size)
+    {
+        _header.size = size;
+
+        if (pwrite(_fd, &_header, sizeof(_header), 0) != static_cast<ssize_t>(sizeof(_header))) {
+            _throw_errno("write header");
+        }
+    }
+
+    void sync(void* ptr, size_t bytes, size_t size)
+    {
+        if (bytes > 0 && msync(ptr, bytes, MS_SYNC) < 0) {
+            _throw_errno("msync");
+        }
+
+        write_size(size);
+
+        if (fsync(_fd) < 0) {
+            _throw_errno("fsync");
+        }
+    }
+
+private:
+    int _fd;
+    bool _closing;
+    size_t _file_size;
+    FileVectorHeader _header;
+
+    static void _throw_errno(const std::string& what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void _open(const std::string& path, size_t element_size)
+    {
+        struct stat info;
+        if (fstat(_fd, &info) < 0) {
+            _throw_errno("stat " + path);
+        }
+
+        size_t page = sysconf(_SC_PAGESIZE);
+
+        if (info.st_size == 0) {
+            std::memcpy(_header.magic, FILE_VECTOR_MAGIC, sizeof(_header.magic));
+            _header.version = FILE_VECTOR_VERSION;
+            _header.element_size = element_size;
+            _header.data_offset = page;
+            _file_size = page;
+
+            write_size(0);
+            _resize(0);
+            return;
+        }
+
+        _file_size = info.st_size;
+
+        if (_file_size < sizeof(_header) || pread(_fd, &_header, sizeof(_header), 0) != sizeof(_header)
+            || std::memcmp(_header.magic, FILE_VECTOR_MAGIC, sizeof(_header.magic)) != 0) {
+            throw std::runtime_error(path + " is not a vector file");
+        }
+        if (_header.version != FILE_VECTOR_VERSION) {
+            throw std::runtime_error(path + " has vector file version " + std::to_string(_header.version));
+        }
+        if (_header.element_size != element_size) {
+            throw std::runtime_error(path + " holds elements of " + std::to_string(_header.element_size) + " bytes");
+        }
+        if (_header.data_offset % page != 0 || _header.data_offset > _file_size
+            || _header.size > data_bytes() / element_size) {
+            throw std::runtime_error(path + " is corrupted");
+        }
+    }
+
+    void _resize(size_t bytes)
+    {
+        if (ftruncate(_fd, _header.data_offset + bytes) < 0) {
+            _throw_errno("ftruncate");
+        }
+
+        _file_size = _header.data_offset + bytes;
+    }
+};
+
+
+// allocator of the one buffer of a FileVector, that buffer is the mapped data of the file
+template <typename T>
+class FileAllocator {
+public:
+    typedef T value_type;
+
+    explicit FileAllocator(std::shared_ptr<MappedFile> file) :
+        _file(std::move(file))
+    { }
+
+    template <typename U>
+    FileAllocator(const FileAllocator<U>& that) :
+        _file(that.file())
+    { }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(_file->map(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        _file->unmap(ptr, n * sizeof(T));
+    }
+
+    T* reallocate(T* ptr, size_t old_n, size_t n)
+    {
+        return static_cast<T*>(_file->remap(ptr, old_n * sizeof(T), n * sizeof(T)));
+    }
+
+    const std::shared_ptr<MappedFile>& file() const
+    {
+        return _file;
+    }
+
+    bool operator== (const FileAllocator& that) const
+    {
+        return _file == that._file;
+    }
+
+    bool operator!= (const FileAllocator& that) const
+    {
+        return _file != that._file;
+    }
+
+private:
+    std::shared_ptr<MappedFile> _file;
+};
+
+
+template <typename T>
+class FileVector : public VectorBase<T, FileAllocator<T>> {
+    static_assert(std::is_trivially_copyable<T>::value, "FileVector stores the bytes of its elements");
+
+    typedef VectorBase<T, FileAllocator<T>> base;
+
+public:
+    // opens the vector stored at `path` or creates an empty one there
+    explicit FileVector(const std::string& path) :
+        base(nullptr, 0, FileAllocator<T>(std::make_shared<MappedFile>(path, sizeof(T))))
+    {
+        MappedFile& file = *this->get_allocator().file();
+        size_t capacity = file.data_bytes() / sizeof(T);
+
+        if (capacity > 0) {
+            this->_adopt(static_cast<T*>(file.map(capacity * sizeof(T))), file.size(), capacity);
+        }
+    }
+
+    // the file has one owner, which keeps its header up to date
+    FileVector(const FileVector&) = delete;
+    FileVector& operator= (const FileVector&) = delete;
+
+   ~FileVector()
+    {
+        MappedFile& file = *this->get_allocator().file();
+
+        file.close_data();
+        try {
+            file.write_size(this->size());
+        }
+        catch(...) { }
+    }
+
+    // flushes the elements and the header to the disk
+    void sync()
+    {
+        this->get_allocator().file()->sync(this->data(), this->capacity() * sizeof(T), this->size());
+    }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "vector.h"
+
+
+// allocator of anonymous private mappings for very large vectors: a vector of trivially relocatable elements
+// is resized with mremap, which moves page table entries instead of copying the elements, so growing never
+// needs the old and the new buffer at once; every mapping is advised to use transparent huge pages
+template <typename T>
+class MmapAllocator {
+public:
+    typedef T value_type;
+
+    MmapAllocator() = default;
+
+    template <typename U>
+    MmapAllocator(const MmapAllocator<U>&)
+    { }
+
+    T* allocate(size_t n)
+    {
+        void* ptr = mmap(nullptr, _bytes(n), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+
+        _advise(ptr, n);
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        munmap(ptr, _bytes(n));
+    }
+
+    T* reallocate(T* ptr, size_t old_n, size_t n)
+    {
+        void* moved = mremap(ptr, _bytes(old_n), _bytes(n), MREMAP_MAYMOVE);
+        if (moved == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+
+        _advise(moved, n);
+        return static_cast<T*>(moved);
+    }
+
+    bool operator== (const MmapAllocator&) const
+    {
+        return true;
+    }
+
+    bool operator!= (const MmapAllocator&) const
+    {
+        return false;
+    }
+
+private:
+    static size_t _bytes(size_t n)
+    {
+        size_t page = sysconf(_SC_PAGESIZE);
+        return (n * sizeof(T) + page - 1) / page * page;
+    }
+
+    static void _advise(void* ptr, size_t n)
+    {
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, _bytes(n), MADV_HUGEPAGE);
+#endif
+    }
+};
+
+
+template <typename T>
+using MmapVector = Vector<T, MmapAllocator<T>>;
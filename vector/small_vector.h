@@ -0,0 +1,88 @@
+#pragma once
+
+#include "vector.h"
+
+
+// vector that stores up to N elements inline and allocates only when it grows past them,
+// so short vectors cost no allocation at all; it shrinks back into the inline buffer as well
+template <typename T, size_t N, typename Allocator = std::allocator<T>>
+class SmallVector : public VectorBase<T, Allocator> {
+    static_assert(N > 0, "SmallVector needs room for at least one inline element");
+
+    typedef VectorBase<T, Allocator> base;
+
+public:
+    typedef typename base::value_type       value_type;
+    typedef typename base::allocator_type   allocator_type;
+
+    SmallVector() :
+        SmallVector(allocator_type())
+    { }
+
+    explicit SmallVector(const allocator_type& allocator) :
+        base(reinterpret_cast<value_type*>(this->_storage), N, allocator)
+    { }
+
+    SmallVector(size_t n, const value_type& value, const allocator_type& allocator = allocator_type()) :
+        SmallVector(allocator)
+    {
+        this->resize(n, value);
+    }
+
+    SmallVector(const SmallVector& that) :
+        SmallVector(static_cast<const base&>(that))
+    { }
+
+    SmallVector(const base& that) :
+        SmallVector(base::_traits::select_on_container_copy_construction(that.get_allocator()))
+    {
+        this->_assign(that);
+    }
+
+    // inline elements of `that` are moved one by one, an allocated buffer is stolen
+    SmallVector(SmallVector&& that) noexcept(std::is_nothrow_move_constructible<value_type>::value) :
+        SmallVector(static_cast<base&&>(that))
+    { }
+
+    SmallVector(base&& that) :
+        SmallVector(that.get_allocator())
+    {
+        this->_take(that);
+    }
+
+    SmallVector& operator= (const SmallVector& that)
+    {
+        base::operator= (that);
+        return *this;
+    }
+
+    SmallVector& operator= (const base& that)
+    {
+        base::operator= (that);
+        return *this;
+    }
+
+    SmallVector& operator= (SmallVector&& that)
+    {
+        base::operator= (std::move(that));
+        return *this;
+    }
+
+    SmallVector& operator= (base&& that)
+    {
+        base::operator= (std::move(that));
+        return *this;
+    }
+
+private:
+    // only its address is taken before the base is constructed, member functions may not be called yet
+    alignas(value_type) unsigned char _storage[N * sizeof(value_type)];
+};
+
+
+#if __cplusplus >= 201703L
+namespace pmr {
+    template <typename T, size_t N>
+    using SmallVector = ::SmallVector<T, N, std::pmr::polymorphic_allocator<T>>;
+}
+#endif
@@ -0,0 +1,340 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mmap_vector.h"
+#include "small_vector.h"
+#include "vector.h"
+
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if (!condition) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+
+// element that counts its live objects and notices being used after it was destroyed;
+// the Relocatable one takes the memcpy paths of Vector, so its value lives on the heap and not in a
+// std::string that may point into itself
+template <bool Relocatable>
+struct Tracked {
+    static long live;
+    static long errors;
+
+    static const unsigned ALIVE = 0xa11fe;
+    static const unsigned DEAD = 0xdead;
+
+    unsigned state;
+    std::unique_ptr<std::string> value;
+
+    Tracked(const std::string& value = "") :
+        state(ALIVE),
+        value(new std::string(value))
+    {
+        live++;
+    }
+
+    Tracked(const Tracked& that) :
+        state(ALIVE),
+        value(_copy(that._checked().value))
+    {
+        live++;
+    }
+
+    Tracked(Tracked&& that) :
+        state(ALIVE),
+        value(std::move(that._checked().value))
+    {
+        live++;
+    }
+
+    Tracked& operator= (const Tracked& that)
+    {
+        _checked().value = _copy(that._checked().value);
+        return *this;
+    }
+
+    Tracked& operator= (Tracked&& that)
+    {
+        _checked().value = std::move(that._checked().value);
+        return *this;
+    }
+
+   ~Tracked()
+    {
+        _checked();
+        state = DEAD;
+        live--;
+    }
+
+    bool operator== (const std::string& that) const
+    {
+        return _checked().value != nullptr && *value == that;
+    }
+
+private:
+    static std::unique_ptr<std::string> _copy(const std::unique_ptr<std::string>& value)
+    {
+        return std::unique_ptr<std::string>(value != nullptr ? new std::string(*value) : nullptr);
+    }
+
+    const Tracked& _checked() const
+    {
+        if (state != ALIVE) {
+            errors++;
+        }
+        return *this;
+    }
+
+    Tracked& _checked()
+    {
+        if (state != ALIVE) {
+            errors++;
+        }
+        return *this;
+    }
+};
+
+template <bool Relocatable> long Tracked<Relocatable>::live = 0;
+template <bool Relocatable> long Tracked<Relocatable>::errors = 0;
+
+template <>
+struct is_trivially_relocatable<Tracked<true>> : std::true_type { };
+
+
+template <typename V>
+bool equal(const V& v, const std::vector<std::string>& expected)
+{
+    if (v.size() != expected.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < v.size(); i++) {
+        if (!(v[i] == expected[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+std::vector<std::string> numbers(size_t n)
+{
+    std::vector<std::string> result;
+    for (size_t i = 0; i < n; i++) {
+        result.push_back("number " + std::to_string(i));
+    }
+    return result;
+}
+
+
+// every element argument refers into the vector itself, at a moment when the vector has to reallocate
+template <typename V>
+void test_self_references(const std::string& name)
+{
+    typedef typename V::value_type T;
+
+    V v;
+    std::vector<std::string> expected(1, "first");
+
+    v.push_back(T("first"));
+
+    // every round fills the vector up first, so it grows by the growth factor each time
+    for (size_t i = 0; i < 16; i++) {
+        while (v.size() < v.capacity()) {
+            v.push_back(std::to_string(v.size()));
+            expected.push_back(std::to_string(expected.size()));
+        }
+
+        switch (i % 4) {
+        case 0:
+            v.push_back(v[0]);
+            break;
+        case 1:
+            v.emplace_back(v[v.size() - 1]);
+            break;
+        case 2:
+            v.emplace(1, v[v.size() / 2]);
+            break;
+        case 3:
+            v.insert(0, v[v.size() - 1]);
+            break;
+        }
+
+        std::string pushed = i % 4 == 0 ? expected[0] : i % 4 == 1 ? expected.back() : i % 4 == 2 ?
+                             expected[expected.size() / 2] : expected.back();
+        expected.insert(expected.begin() + (i % 4 == 2 ? 1 : i % 4 == 3 ? 0 : expected.size()), pushed);
+    }
+    check(equal(v, expected), name + ": push_back/emplace/insert of an element of the same vector");
+
+    // the filled elements are copies of an element that lives in the old buffer
+    size_t size = v.size();
+    v.shrink_to_fit();
+    v.resize(3 * size, v[1]);
+    expected.resize(3 * size, expected[1]);
+    check(equal(v, expected), name + ": resize(n, v[k]) across a reallocation");
+
+    v.shrink_to_fit();
+    v.append(v.begin() + 2, v.begin() + 40);
+    std::vector<std::string> range(expected.begin() + 2, expected.begin() + 40);
+    expected.insert(expected.end(), range.begin(), range.end());
+    check(equal(v, expected), name + ": append of a range of the same vector");
+
+    v.shrink_to_fit();
+    v.insert(5, v.begin() + 10, v.begin() + 30);
+    range.assign(expected.begin() + 10, expected.begin() + 30);
+    expected.insert(expected.begin() + 5, range.begin(), range.end());
+    check(equal(v, expected), name + ": insert of a range of the same vector");
+
+    while (v.size() > 10) {
+        v.erase(v.size() / 2);
+        expected.erase(expected.begin() + expected.size() / 2);
+    }
+    check(equal(v, expected), name + ": erase with shrinking");
+}
+
+
+template <typename T>
+void test_small_vector(const std::string& name)
+{
+    typedef SmallVector<T, 4> Small;
+
+    std::vector<std::string> three = numbers(3), ten = numbers(10);
+
+    Small inline_one, heap_one;
+    inline_one.append(three.begin(), three.end());
+    heap_one.append(ten.begin(), ten.end());
+
+    Small copied(inline_one), heap_copied(heap_one);
+    check(equal(copied, three) && equal(heap_copied, ten), name + ": copy of inline and heap SmallVectors");
+
+    Small moved(std::move(copied)), heap_moved(std::move(heap_copied));
+    check(equal(moved, three) && equal(heap_moved, ten) && copied.empty() && heap_copied.empty(),
+          name + ": move of inline and heap SmallVectors");
+
+    moved.swap(heap_moved);
+    check(equal(moved, ten) && equal(heap_moved, three), name + ": swap of an inline and a heap SmallVector");
+
+    moved.swap(heap_moved);
+    heap_moved = moved;
+    check(equal(heap_moved, three), name + ": copy assignment of an inline SmallVector to a heap one");
+
+    heap_moved = std::move(heap_one);
+    check(equal(heap_moved, ten) && heap_one.empty(), name + ": move assignment of a heap SmallVector");
+
+    // growing past the inline buffer and shrinking back into it
+    Small grown;
+    grown.append(ten.begin(), ten.end());
+    while (grown.size() > 2) {
+        grown.pop_back();
+    }
+    grown.shrink_to_fit();
+    check(equal(grown, numbers(2)) && grown.capacity() == 4, name + ": SmallVector shrinks back into its buffer");
+
+    // a Vector and a SmallVector share the VectorBase interface
+    Vector<T> vector;
+    vector.append(ten.begin(), ten.end());
+
+    VectorBase<T>& small_base = inline_one;
+    VectorBase<T>& vector_base = vector;
+
+    small_base.swap(vector_base);
+    check(equal(inline_one, ten) && equal(vector, three), name + ": swap of a SmallVector and a Vector");
+
+    vector_base.swap(small_base);
+    check(equal(inline_one, three) && equal(vector, ten), name + ": swap back of a Vector and a SmallVector");
+
+    Vector<T> from_small(inline_one);
+    Small from_vector(vector);
+    check(equal(from_small, three) && equal(from_vector, ten), name + ": copies between Vector and SmallVector");
+}
+
+
+template <typename T>
+void test_lifetimes(const std::string& name)
+{
+    {
+        test_self_references<Vector<T>>(name + " Vector");
+        test_self_references<SmallVector<T, 8>>(name + " SmallVector");
+        test_small_vector<T>(name);
+
+        Vector<T> v(5, T("x"));
+        v.resize(100);
+        v.resize(2);
+        v.clear();
+        v.resize(7, T("y"));
+        check(equal(v, std::vector<std::string>(7, "y")), name + ": resize and clear");
+    }
+
+    check(T::live == 0, name + ": every constructed element is destroyed");
+    check(T::errors == 0, name + ": no element is used or destroyed after its destruction");
+}
+
+
+// MmapAllocator that counts the blocks resized in place of being reallocated
+template <typename T>
+struct CountingMmapAllocator : MmapAllocator<T> {
+    static size_t reallocations;
+
+    CountingMmapAllocator() = default;
+
+    template <typename U>
+    CountingMmapAllocator(const CountingMmapAllocator<U>&)
+    { }
+
+    T* reallocate(T* ptr, size_t old_n, size_t n)
+    {
+        reallocations++;
+        return MmapAllocator<T>::reallocate(ptr, old_n, n);
+    }
+};
+
+template <typename T> size_t CountingMmapAllocator<T>::reallocations = 0;
+
+
+void test_mmap_vector()
+{
+    check(has_reallocate<MmapAllocator<long>>::value, "MmapAllocator resizes blocks");
+
+    Vector<long, CountingMmapAllocator<long>> v;
+    const long n = 10000000;
+
+    for (long i = 0; i < n; i++) {
+        v.push_back(i);
+    }
+
+    bool same = true;
+    for (long i = 0; i < n; i++) {
+        same = same && v[i] == i;
+    }
+    check(same, "MmapVector keeps its elements through mremap growth");
+    check(CountingMmapAllocator<long>::reallocations > 10, "MmapVector grows through mremap");
+
+    v.resize(10);
+    v.shrink_to_fit();
+    check(v.size() == 10 && v[9] == 9, "MmapVector shrinks through mremap");
+
+    MmapVector<std::string> strings;
+    std::vector<std::string> expected = numbers(10000);
+    strings.append(expected.begin(), expected.end());
+    check(equal(strings, expected), "MmapVector of elements that are not trivially relocatable");
+}
+
+
+int main()
+{
+    test_lifetimes<Tracked<false>>("copied elements");
+    test_lifetimes<Tracked<true>>("relocated elements");
+    test_mmap_vector();
+
+    std::cout << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
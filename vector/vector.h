@@ -1,11 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <stdexcept>
 #include <memory>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
 
 
+// types whose objects can be moved to another address with memcpy, leaving nothing to destroy at the old one;
+// Vector shifts and reallocates them in blocks. Specialize as std::true_type for such user types,
+// e.g. a struct holding a std::unique_ptr
 template <typename T>
-class Vector {
+struct is_trivially_relocatable : std::is_trivially_copyable<T> { };
+
+
+// allocators with a `T* reallocate(T* ptr, size_t old_n, size_t n)` that resizes a block keeping its bytes,
+// possibly at another address; Vector uses it to grow and shrink trivially relocatable elements
+template <typename Allocator, typename = void>
+struct has_reallocate : std::false_type { };
+
+template <typename Allocator>
+struct has_reallocate<Allocator, decltype(void(std::declval<Allocator&>().reallocate(
+    static_cast<typename Allocator::value_type*>(nullptr), size_t(), size_t())))> : std::true_type { };
+
+
+// capacity policy of a vector: a full vector grows to grow_factor times the size it needs, one whose size
+// falls below shrink_threshold of its capacity shrinks to grow_factor times its size, 0 never shrinks.
+// shrink_threshold must be below 1 / grow_factor, so that a pop right after a growth or a push right after
+// a shrink never reallocates again
+struct GrowthPolicy {
+    float grow_factor;
+    float shrink_threshold;
+};
+
+const GrowthPolicy DEFAULT_GROWTH = {1.5, 0.25};
+const GrowthPolicy NO_SHRINK_GROWTH = {1.5, 0};
+
+
+// everything of Vector except the constructors: the storage is either allocated or, for SmallVector,
+// an inline buffer owned by the derived object. Functions that take a VectorBase<T>& accept both kinds
+template <typename T, typename Allocator = std::allocator<T>>
+class VectorBase {
 public:
     typedef T                                       value_type;
+    typedef Allocator                               allocator_type;
     typedef value_type*                             pointer;    
     typedef value_type&                             reference;
     typedef const pointer                           const_pointer;
@@ -14,32 +59,12 @@ public:
     typedef std::reverse_iterator<iterator>         reverse_iterator;
     typedef const iterator                          const_iterator;
     typedef std::reverse_iterator<const_iterator>   const_reverse_iterator;
-    
-    Vector() :
-        _data(nullptr),
-        _size(0),
-        _capacity(0)
-    { }
 
-    Vector(size_t n, const value_type& value) :
-        Vector()
-    {
-        _realloc(n);
+    VectorBase(const VectorBase&) = delete;
 
-        for (size_t i = 0; i < n; i++) {
-            push_back(value);
-        }
-    }
-
-    Vector(const Vector& that) :
-        Vector()
+    allocator_type get_allocator() const
     {
-        *this = that;
-    }
-
-   ~Vector()
-    {
-        _free(_data, _size);
+        return _allocator;
     }
 
     size_t size() const
@@ -64,17 +89,47 @@ public:
 
     void reserve(size_t n)
     {
-        if (n > _size) {
+        if (n > _capacity) {
             _realloc(n);
         }
     }
 
+    void shrink_to_fit()
+    {
+        if (_size < _capacity) {
+            _realloc(_size);
+        }
+    }
+
+    const GrowthPolicy& growth_policy() const
+    {
+        return _growth;
+    }
+
+    // the policy belongs to this object, copies and moves start with DEFAULT_GROWTH
+    void set_growth_policy(const GrowthPolicy& policy)
+    {
+        if (!(policy.grow_factor > 1) || policy.shrink_threshold < 0 || policy.shrink_threshold * policy.grow_factor >= 1) {
+            throw std::invalid_argument("growth policy without hysteresis");
+        }
+
+        _growth = policy;
+    }
+
     void resize(size_t n)
     {
-        _realloc(n);
+        _resize(n);
+    }
 
-        for (size_t i = _size; i < n; i++) {
-            push_back(value_type());
+    void resize(size_t n, const value_type& value)
+    {
+        if (n > _capacity) {
+            // the value may refer to an element of this vector, copy it before reallocating
+            value_type copy(value);
+            _resize(n, copy);
+        }
+        else {
+            _resize(n, value);
         }
     }
 
@@ -100,60 +155,136 @@ public:
 
     void push_back(const value_type& value)
     {
-        insert(_size, value);
+        emplace_back(value);
     }
 
-    void pop_back()
+    void push_back(value_type&& value)
     {
-        erase(_size - 1);
+        emplace_back(std::move(value));
     }
 
-    void insert(size_t pos, const value_type& value)
+    template <typename... Args>
+    reference emplace_back(Args&&... args)
     {
         if (_size == _capacity) {
+            // the arguments may refer to an element of this vector, construct before reallocating
+            value_type value(std::forward<Args>(args)...);
             _realloc_ahead(_size + 1);
-        }
-        if (_size != 0) {
-            new(&_data[_size]) value_type(_data[_size - 1]);
-            for (size_t i = _size - 1; i > pos; i--) {
-                _data[i] = _data[i - 1];
-            }
-            _data[pos] = value;
+            _construct(_data + _size, std::move(value));
         }
         else {
-            new(&_data[_size]) value_type(value);
+            _construct(_data + _size, std::forward<Args>(args)...);
         }
 
         _size++;
+
+        return back();
     }
 
-    void erase(size_t n)
+    void pop_back()
     {
-        for (size_t i = n; i < _size - 1; i++) {
-            _data[i] = _data[i + 1];
+        erase(_size - 1);
+    }
+
+    void insert(size_t pos, const value_type& value)
+    {
+        emplace(pos, value);
+    }
+
+    void insert(size_t pos, value_type&& value)
+    {
+        emplace(pos, std::move(value));
+    }
+
+    // inserts the whole range with at most one reallocation when its length is known up front
+    template <typename InputIt>
+    void insert(size_t pos, InputIt first, InputIt last)
+    {
+        size_t size = _size;
+
+        append(first, last);
+        std::rotate(_data + pos, _data + size, _data + _size);
+    }
+
+    template <typename InputIt>
+    void append(InputIt first, InputIt last)
+    {
+        _append(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+    }
+
+    template <typename... Args>
+    void emplace(size_t pos, Args&&... args)
+    {
+        if (pos == _size) {
+            emplace_back(std::forward<Args>(args)...);
+            return;
         }
 
-        _data[_size - 1].~value_type();
+        value_type value(std::forward<Args>(args)...);
+
+        if (_size == _capacity) {
+            _realloc_ahead(_size + 1);
+        }
+
+        _insert_shifted(pos, value, _relocatable());
+        _size++;
+    }
+
+    void erase(size_t n)
+    {
+        _erase_shifted(n, _relocatable());
         _size--;
 
-        if (_size < DECREASE_FACTOR * _capacity) {
-            _realloc_ahead(_size);
+        _shrink();
+    }
+
+    VectorBase& operator= (const VectorBase& that)
+    {
+        if (this == &that) {
+            return *this;
+        }
+
+        if (_propagate_copy::value && !(_allocator == that._allocator)) {
+            _reset();
         }
+        _propagate(that._allocator, _propagate_copy());
+        _assign(that);
+
+        return *this;
     }
 
-    Vector<value_type>& operator= (const Vector<T>& that)
+    VectorBase& operator= (VectorBase&& that)
     {
-        pointer tmp = _alloc_and_copy(that.capacity(), that.data(), that.size());
-        
-        std::swap(_data, tmp);
-        _free(tmp, _size);
+        if (this == &that) {
+            return *this;
+        }
 
-        _size = that.size();
-        _capacity = that.capacity();
+        _reset();
+        _propagate(that._allocator, _propagate_move());
+        _take(that);
 
         return *this;
     }
 
+    // allocators that do not propagate on swap must be equal, as for the standard containers
+    void swap(VectorBase& that)
+    {
+        _swap_allocator(that, typename _traits::propagate_on_container_swap());
+
+        if (!_is_inline() && !that._is_inline()) {
+            std::swap(_data, that._data);
+            std::swap(_size, that._size);
+            std::swap(_capacity, that._capacity);
+            return;
+        }
+
+        // inline elements cannot change hands, they are moved through a temporary
+        VectorBase tmp(nullptr, 0, _allocator);
+        tmp._take(that);
+        that._take(*this);
+        _take(tmp);
+    }
+
     pointer data()
     {
         return _data;
@@ -226,13 +357,91 @@ public:
         return std::reverse_iterator<const_iterator>(cbegin());;
     }
 
+protected:
+    typedef std::allocator_traits<allocator_type> _traits;
+    typedef typename _traits::propagate_on_container_copy_assignment _propagate_copy;
+    typedef typename _traits::propagate_on_container_move_assignment _propagate_move;
+
+    // an empty vector that uses the inline buffer (if any) until more than inline_capacity elements are stored
+    VectorBase(pointer inline_data, size_t inline_capacity, const allocator_type& allocator) :
+        _size(0),
+        _capacity(inline_capacity),
+        _data(inline_data),
+        _allocator(allocator),
+        _inline(inline_data),
+        _inline_capacity(inline_capacity)
+    { }
+
+   ~VectorBase()
+    {
+        _free(_data, _capacity, _size);
+    }
+
+    // replaces the elements by copies of those of `that`, keeps the allocator
+    void _assign(const VectorBase& that)
+    {
+        _destroy(_data, _size);
+        _size = 0;
+
+        if (that._size > _capacity) {
+            _realloc(that._size);
+        }
+
+        _copy_to(_data, that._data, that._size, _trivially_copyable());
+        _size = that._size;
+    }
+
+    // takes over a buffer of `capacity` elements from our allocator whose `size` first elements are constructed
+    void _adopt(pointer data, size_t size, size_t capacity)
+    {
+        _reset();
+        _data = data;
+        _size = size;
+        _capacity = capacity;
+    }
+
+    // moves the elements of `that` into this empty vector and leaves `that` empty: an allocated buffer
+    // is stolen if our allocator can free it, inline elements or foreign buffers are relocated one by one
+    void _take(VectorBase& that)
+    {
+        if (that._data == nullptr) {
+            return;
+        }
+
+        if (!that._is_inline() && _allocator == that._allocator) {
+            _free(_data, _capacity);
+            _data = that._data;
+            _size = that._size;
+            _capacity = that._capacity;
+
+            that._data = that._inline;
+            that._size = 0;
+            that._capacity = that._inline_capacity;
+            return;
+        }
+
+        if (that._size > _capacity) {
+            _realloc(that._size);
+        }
+
+        _relocate(_data, that._data, that._size, _relocatable());
+        _size = that._size;
+        that._size = 0;
+    }
+
 private:
-    const float INCREASE_FACTOR = 1.5;
-    const float DECREASE_FACTOR = 0.5;
+    GrowthPolicy _growth = DEFAULT_GROWTH;
+
+    typedef std::integral_constant<bool, is_trivially_relocatable<value_type>::value> _relocatable;
+    typedef std::integral_constant<bool, std::is_trivially_copyable<value_type>::value> _trivially_copyable;
+    typedef std::integral_constant<bool, _relocatable::value && has_reallocate<allocator_type>::value> _block_reallocatable;
 
     size_t _size;
     size_t _capacity;
     pointer _data;
+    allocator_type _allocator;
+    pointer _inline;
+    size_t _inline_capacity;
 
     void _range_check(size_t n) const
     {
@@ -243,56 +452,400 @@ private:
 
     pointer _alloc(size_t n)
     {
-        auto tmp = std::get_temporary_buffer<value_type> (n);
-        if (tmp.second != n) {
-            _free(tmp.first);
-            throw std::bad_alloc();
-        }
+        return n > 0 ? _traits::allocate(_allocator, n) : nullptr;
+    }
 
-        return tmp.first;
+    template <typename... Args>
+    void _construct(pointer ptr, Args&&... args)
+    {
+        _traits::construct(_allocator, ptr, std::forward<Args>(args)...);
     }
 
-    void _free(pointer ptr, size_t n = 0)
+    void _destroy(pointer ptr, size_t n)
     {
         for (size_t i = 0; i < n; i++) {
-            ptr[i].~value_type();
+            _traits::destroy(_allocator, ptr + i);
         }
+    }
 
-        std::return_temporary_buffer(ptr);
+    bool _is_inline() const
+    {
+        return _inline != nullptr && _data == _inline;
     }
 
-    pointer _alloc_and_copy(size_t size, pointer from, size_t n)
+    // destroys the n first elements of a buffer of `capacity` elements and deallocates it unless it is inline
+    void _free(pointer ptr, size_t capacity, size_t n = 0)
+    {
+        _destroy(ptr, n);
+
+        if (ptr != nullptr && ptr != _inline) {
+            _traits::deallocate(_allocator, ptr, capacity);
+        }
+    }
+
+    void _reset()
+    {
+        _free(_data, _capacity, _size);
+        _data = _inline;
+        _size = 0;
+        _capacity = _inline_capacity;
+    }
+
+    // polymorphic allocators cannot even be assigned, so they are only touched when the traits ask for it
+    void _propagate(const allocator_type& allocator, std::true_type)
+    {
+        _allocator = allocator;
+    }
+
+    void _propagate(const allocator_type&, std::false_type)
+    { }
+
+    void _swap_allocator(VectorBase& that, std::true_type)
+    {
+        std::swap(_allocator, that._allocator);
+    }
+
+    void _swap_allocator(VectorBase&, std::false_type)
+    { }
+
+    void _copy_to(pointer to, const value_type* from, size_t n, std::true_type)
+    {
+        if (n > 0) {
+            std::memcpy(to, from, n * sizeof(value_type));
+        }
+    }
+
+    void _copy_to(pointer to, const value_type* from, size_t n, std::false_type)
     {
-        pointer to = _alloc(size);
         size_t copied = 0;
 
         try {
             for (size_t i = 0; i < n; i++, copied++) {
-                new(to + i) value_type(from[i]);
+                _construct(to + i, from[i]);
             }
         }
         catch(...) {
-            _free(to, copied);
+            _destroy(to, copied);
             throw;
         }
+    }
 
-        return to;
+    // moves n elements to `to` in one block, the old copies must not be destroyed
+    void _relocate(pointer to, pointer from, size_t n, std::true_type)
+    {
+        if (n > 0) {
+            std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), n * sizeof(value_type));
+        }
     }
 
+    // moves the elements if that cannot throw, copies them otherwise so that a throwing copy leaves the source intact
+    void _relocate(pointer to, pointer from, size_t n, std::false_type)
+    {
+        size_t moved = 0;
+
+        try {
+            for (size_t i = 0; i < n; i++, moved++) {
+                _construct(to + i, std::move_if_noexcept(from[i]));
+            }
+        }
+        catch(...) {
+            _destroy(to, moved);
+            throw;
+        }
+
+        _destroy(from, n);
+    }
+
+    // buffers of up to _inline_capacity elements are the inline one
     void _realloc(size_t n)
     {
         size_t new_size = std::min(_size, n);
 
-        pointer tmp = _alloc_and_copy(n, _data, new_size);
-        std::swap(_data, tmp);
-
-        _free(tmp, _size);
+        _destroy(_data + new_size, _size - new_size);
         _size = new_size;
+
+        if (_is_inline() && n <= _inline_capacity) {
+            return;
+        }
+
+        if (_data != nullptr && !_is_inline() && n > _inline_capacity && _reallocate(n, _block_reallocatable())) {
+            return;
+        }
+
+        pointer tmp = n <= _inline_capacity ? _inline : _alloc(n);
+        try {
+            _relocate(tmp, _data, _size, _relocatable());
+        }
+        catch(...) {
+            _free(tmp, n);
+            throw;
+        }
+
+        _free(_data, _capacity);
+        _data = tmp;
+        _capacity = std::max(n, _inline_capacity);
+    }
+
+    bool _reallocate(size_t n, std::true_type)
+    {
+        _data = _allocator.reallocate(_data, _capacity, n);
         _capacity = n;
+
+        return true;
+    }
+
+    bool _reallocate(size_t, std::false_type)
+    {
+        return false;
+    }
+
+    void _insert_shifted(size_t pos, value_type& value, std::true_type)
+    {
+        std::memmove(static_cast<void*>(_data + pos + 1), static_cast<const void*>(_data + pos),
+                     (_size - pos) * sizeof(value_type));
+        _construct(_data + pos, std::move(value));
+    }
+
+    void _insert_shifted(size_t pos, value_type& value, std::false_type)
+    {
+        _construct(_data + _size, std::move(_data[_size - 1]));
+        for (size_t i = _size - 1; i > pos; i--) {
+            _data[i] = std::move(_data[i - 1]);
+        }
+        _data[pos] = std::move(value);
+    }
+
+    void _erase_shifted(size_t n, std::true_type)
+    {
+        _destroy(_data + n, 1);
+        std::memmove(static_cast<void*>(_data + n), static_cast<const void*>(_data + n + 1),
+                     (_size - n - 1) * sizeof(value_type));
+    }
+
+    void _erase_shifted(size_t n, std::false_type)
+    {
+        for (size_t i = n; i < _size - 1; i++) {
+            _data[i] = std::move(_data[i + 1]);
+        }
+        _destroy(_data + _size - 1, 1);
+    }
+
+    size_t _grown(size_t n) const
+    {
+        return std::max(n + 1, static_cast<size_t>(_growth.grow_factor * n));
     }
 
     void _realloc_ahead(size_t n)
     {
-        _realloc(INCREASE_FACTOR * n);
+        _realloc(_grown(n));
     }
-};
\ No newline at end of file
+
+    void _shrink()
+    {
+        if (_size < _growth.shrink_threshold * _capacity && _grown(_size) < _capacity) {
+            _realloc(_grown(_size));
+        }
+    }
+
+    template <typename... Args>
+    void _resize(size_t n, const Args&... value)
+    {
+        if (n < _size) {
+            _destroy(_data + n, _size - n);
+            _size = n;
+            _shrink();
+            return;
+        }
+
+        reserve(n);
+
+        for (; _size < n; _size++) {
+            _construct(_data + _size, value...);
+        }
+    }
+
+    template <typename InputIt>
+    void _append(InputIt first, InputIt last, std::input_iterator_tag)
+    {
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+    }
+
+    template <typename ForwardIt>
+    void _append(ForwardIt first, ForwardIt last, std::forward_iterator_tag)
+    {
+        size_t n = std::distance(first, last);
+
+        if (_size + n > _capacity) {
+            if (!_block_reallocatable::value || _data == nullptr || _is_inline()) {
+                _append_copied(first, n);
+                return;
+            }
+
+            _grow_in_place(first, n, _block_reallocatable());
+        }
+
+        for (size_t i = 0; i < n; i++, ++first, _size++) {
+            _construct(_data + _size, *first);
+        }
+    }
+
+    // the range may be part of this vector, so it is copied to the new buffer before the old one is released
+    template <typename ForwardIt>
+    void _append_copied(ForwardIt first, size_t n)
+    {
+        size_t capacity = _grown(_size + n);
+        pointer tmp = capacity <= _inline_capacity ? _inline : _alloc(capacity);
+        size_t constructed = 0;
+
+        try {
+            for (; constructed < n; ++first, constructed++) {
+                _construct(tmp + _size + constructed, *first);
+            }
+            _relocate(tmp, _data, _size, _relocatable());
+        }
+        catch(...) {
+            _destroy(tmp + _size, constructed);
+            _free(tmp, capacity);
+            throw;
+        }
+
+        _free(_data, _capacity);
+        _data = tmp;
+        _size += n;
+        _capacity = tmp == _inline ? _inline_capacity : capacity;
+    }
+
+    // the buffer may move when it is resized, a range that is part of it has to follow
+    template <typename ForwardIt>
+    void _grow_in_place(ForwardIt& first, size_t n, std::true_type)
+    {
+        typedef std::is_convertible<ForwardIt, const value_type*> is_pointer;
+
+        size_t pos = _position(first, is_pointer());
+        _reallocate(_grown(_size + n), std::true_type());
+
+        if (pos < _size) {
+            _rebase(first, pos, is_pointer());
+        }
+    }
+
+    template <typename ForwardIt>
+    void _grow_in_place(ForwardIt&, size_t, std::false_type)
+    { }
+
+    // index of the element `it` points to or _size if it does not point into this vector
+    template <typename It>
+    size_t _position(It it, std::true_type) const
+    {
+        std::less<const value_type*> less;
+        return !less(it, _data) && less(it, _data + _size) ? it - _data : _size;
+    }
+
+    template <typename It>
+    size_t _position(It, std::false_type) const
+    {
+        return _size;
+    }
+
+    template <typename It>
+    void _rebase(It& it, size_t pos, std::true_type)
+    {
+        it = _data + pos;
+    }
+
+    template <typename It>
+    void _rebase(It&, size_t, std::false_type)
+    { }
+};
+
+
+template <typename T, typename Allocator = std::allocator<T>>
+class Vector : public VectorBase<T, Allocator> {
+    typedef VectorBase<T, Allocator> base;
+
+public:
+    typedef typename base::value_type       value_type;
+    typedef typename base::allocator_type   allocator_type;
+
+    Vector() :
+        Vector(allocator_type())
+    { }
+
+    explicit Vector(const allocator_type& allocator) :
+        base(nullptr, 0, allocator)
+    { }
+
+    Vector(size_t n, const value_type& value, const allocator_type& allocator = allocator_type()) :
+        Vector(allocator)
+    {
+        this->resize(n, value);
+    }
+
+    Vector(const Vector& that) :
+        Vector(static_cast<const base&>(that))
+    { }
+
+    Vector(const base& that) :
+        Vector(that, base::_traits::select_on_container_copy_construction(that.get_allocator()))
+    { }
+
+    Vector(const base& that, const allocator_type& allocator) :
+        Vector(allocator)
+    {
+        this->_assign(that);
+    }
+
+    // a Vector never stores its elements inline, so its buffer is always stolen
+    Vector(Vector&& that) noexcept :
+        Vector(that.get_allocator())
+    {
+        this->_take(that);
+    }
+
+    Vector(base&& that) :
+        Vector(that.get_allocator())
+    {
+        this->_take(that);
+    }
+
+    // steals the buffer of `that` if its allocator can free it, moves the elements one by one otherwise
+    Vector(base&& that, const allocator_type& allocator) :
+        Vector(allocator)
+    {
+        this->_take(that);
+    }
+
+    Vector& operator= (const Vector& that)
+    {
+        base::operator= (that);
+        return *this;
+    }
+
+    Vector& operator= (const base& that)
+    {
+        base::operator= (that);
+        return *this;
+    }
+
+    Vector& operator= (Vector&& that) noexcept(base::_propagate_move::value || base::_traits::is_always_equal::value)
+    {
+        base::operator= (std::move(that));
+        return *this;
+    }
+
+    Vector& operator= (base&& that)
+    {
+        base::operator= (std::move(that));
+        return *this;
+    }
+};
+
+#if __cplusplus >= 201703L
+namespace pmr {
+    // vector that allocates from a std::pmr::memory_resource, e.g. an arena released in one go
+    template <typename T>
+    using Vector = ::Vector<T, std::pmr::polymorphic_allocator<T>>;
+}
+#endif